@@ -0,0 +1,95 @@
+#include "../head/buddy.h"
+#include "bench.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// aligned_malloc con alineacion mayor, igual y menor que el tamano (buffers
+// de constantes de 256 B alineados a 4 KB, paginas de 4 KB, texturas de
+// 100 KB alineadas a 64 B) y con alineacion 0, que equivale a MinBlock.
+// Cada caso llena el heap hasta el primer fallo, comprueba la alineacion y
+// el contenido de cada bloque y lo libera con free(ptr, max(size,
+// alignment)); el heap debe quedar vacio. Con make DEBUG=1 free comprueba
+// ademas ese tamano contra el orden guardado.
+// Despues se mide una pareja aligned_malloc/free frente a malloc/free.
+
+namespace {
+
+constexpr size_t k_rounds = 1000000;
+
+struct Case {
+  const char *label;
+  size_t size;
+  size_t alignment;
+};
+
+void check(Default_buddy &buddy, const Case &c) {
+  std::vector<unsigned char *> live;
+  size_t misaligned = 0, corrupted = 0;
+  const size_t alignment =
+      c.alignment ? c.alignment : Default_buddy::k_min_block;
+  for (;;) {
+    auto ptr =
+        static_cast<unsigned char *>(buddy.aligned_malloc(c.size, c.alignment));
+    if (!ptr)
+      break;
+    misaligned += reinterpret_cast<uintptr_t>(ptr) & (alignment - 1) ||
+                  buddy.usable_size(ptr) < c.size;
+    std::memset(ptr, static_cast<int>(live.size()), c.size);
+    live.push_back(ptr);
+  }
+  for (size_t i = 0; i < live.size(); ++i)
+    corrupted += live[i][0] != static_cast<unsigned char>(i) ||
+                 live[i][c.size - 1] != static_cast<unsigned char>(i);
+  const size_t rounded = std::max(c.size, alignment);
+  for (unsigned char *ptr : live)
+    buddy.free(ptr, rounded);
+
+  std::cout << c.label << ": " << live.size() << " bloques (free con "
+            << rounded << " B), " << misaligned << " mal alineados, " << corrupted
+            << " con contenido distinto, heap "
+            << (buddy.empty() ? "vacio" : "no vacio!") << "\n";
+}
+
+} // namespace
+
+int main() {
+  static Default_buddy buddy;
+  const Case cases[] = {
+      {"Alineacion > tamano (256 B a 4 KB)  ", 256, 4096},
+      {"Alineacion = tamano (4 KB a 4 KB)   ", 4096, 4096},
+      {"Alineacion < tamano (100 KB a 64 B) ", 100 * 1024, 64},
+      {"Alineacion 0 (= MinBlock, 1000 B)   ", 1000, 0},
+  };
+  for (const Case &c : cases)
+    check(buddy, c);
+
+  // Alineaciones invalidas: no potencia de 2 o mayor que el heap
+  std::cout << "Alineacion 48 o 2 * k_size: "
+            << (buddy.aligned_malloc(64, 48) ||
+                        buddy.aligned_malloc(64, 2 * Default_buddy::k_size)
+                    ? "aceptada!"
+                    : "rechazada")
+            << "\n";
+
+  Xorshift rng;
+  const double plain_ns = time_ns([&] {
+    for (size_t i = 0; i < k_rounds; ++i) {
+      const size_t size = size_t(64) << rng.next() % 6;
+      void *ptr = buddy.malloc(size);
+      do_not_optimize(ptr);
+      buddy.free(ptr, size);
+    }
+  });
+  report("malloc/free", plain_ns, 2 * k_rounds);
+  const double aligned_ns = time_ns([&] {
+    for (size_t i = 0; i < k_rounds; ++i) {
+      const size_t size = size_t(64) << rng.next() % 6;
+      void *ptr = buddy.aligned_malloc(size, 4096);
+      do_not_optimize(ptr);
+      buddy.free(ptr, std::max<size_t>(size, 4096));
+    }
+  });
+  report("aligned_malloc(4 KB)/free", aligned_ns, 2 * k_rounds);
+  return 0;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Utilidades comunes de los microbenchmarks (bench/*.cpp)
+
+// Mide el tiempo de f() en nanosegundos
+template <typename F> double time_ns(F &&f) {
+  const auto start = std::chrono::steady_clock::now();
+  f();
+  const auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+// Generador xorshift: barato y determinista entre ejecuciones
+struct Xorshift {
+  uint64_t state = 0x9E3779B97F4A7C15ull;
+  uint64_t next() {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+  }
+};
+
+inline void report(const std::string &name, double ns, size_t ops) {
+  std::cout << std::left << std::setw(40) << name << std::right << std::fixed
+            << std::setprecision(2) << std::setw(10) << ns / ops
+            << " ns/op\n";
+}
+
+// Secuencia fija de tamanos de textura: lado 64 .. 1024 px no
+// necesariamente potencia de 2, 3 o 4 canales
+inline std::vector<size_t> texture_sizes(size_t count = 4096) {
+  Xorshift rng;
+  std::vector<size_t> sizes;
+  for (size_t i = 0; i < count; ++i) {
+    const uint64_t r = rng.next();
+    const size_t width = 64 + (r >> 8) % 961;
+    const size_t height = 64 + (r >> 24) % 961;
+    const size_t channels = 3 + (r >> 40) % 2;
+    sizes.push_back(width * height * channels);
+  }
+  return sizes;
+}
+
+// Evita que el compilador elimine resultados no usados
+inline void do_not_optimize(void *p) { asm volatile("" : : "g"(p) : "memory"); }
+
+#endif // BENCH_H
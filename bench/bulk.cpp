@@ -0,0 +1,88 @@
+#include "../head/buddy.h"
+#include "bench.h"
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+// Reserva y liberacion por lotes frente a N llamadas individuales.
+// Cada ronda pide k_count bloques del mismo tamano (particulas, paginas de
+// tiles) sobre un heap vacio y los libera en orden aleatorio: malloc parte
+// un bloque grande nivel a nivel en cada llamada, malloc_bulk lo trocea de
+// una vez; free coalesce puntero a puntero, free_bulk une antes los hermanos.
+// free_bulk se mide con los punteros en el orden en que los dio malloc_bulk
+// y barajados (incluye la ordenacion).
+
+namespace {
+
+constexpr size_t k_count = 512;
+constexpr size_t k_rounds = 2000;
+
+void run(size_t size) {
+  static Default_buddy buddy;
+  std::vector<void *> ptrs(k_count);
+  std::vector<size_t> order(k_count);
+  for (size_t i = 0; i < k_count; ++i)
+    order[i] = i;
+  std::mt19937 rng(42);
+
+  double alloc_ns = 0, free_ns = 0;
+  for (size_t round = 0; round < k_rounds; ++round) {
+    alloc_ns += time_ns([&] {
+      for (size_t i = 0; i < k_count; ++i)
+        ptrs[i] = buddy.malloc(size);
+    });
+    std::shuffle(order.begin(), order.end(), rng);
+    free_ns += time_ns([&] {
+      for (size_t i : order)
+        buddy.free(ptrs[i]);
+    });
+  }
+  const std::string suffix = " (" + std::to_string(size) + " B)";
+  report("malloc x" + std::to_string(k_count) + suffix, alloc_ns,
+         k_rounds * k_count);
+  report("free x" + std::to_string(k_count) + suffix, free_ns,
+         k_rounds * k_count);
+
+  // free con tamano: el orden sale de size sin leer los metadatos
+  free_ns = 0;
+  for (size_t round = 0; round < k_rounds; ++round) {
+    for (size_t i = 0; i < k_count; ++i)
+      ptrs[i] = buddy.malloc(size);
+    std::shuffle(order.begin(), order.end(), rng);
+    free_ns += time_ns([&] {
+      for (size_t i : order)
+        buddy.free(ptrs[i], size);
+    });
+  }
+  report("free(ptr, size) x" + std::to_string(k_count) + suffix, free_ns,
+         k_rounds * k_count);
+
+  alloc_ns = free_ns = 0;
+  double shuffled_ns = 0;
+  std::vector<void *> shuffled(k_count);
+  for (size_t round = 0; round < k_rounds; ++round) {
+    alloc_ns += time_ns(
+        [&] { do_not_optimize(ptrs.data() + buddy.malloc_bulk(
+                                  k_count, size, ptrs.data())); });
+    free_ns += time_ns([&] { buddy.free_bulk(ptrs.data(), k_count); });
+
+    buddy.malloc_bulk(k_count, size, ptrs.data());
+    std::shuffle(order.begin(), order.end(), rng);
+    for (size_t i = 0; i < k_count; ++i)
+      shuffled[i] = ptrs[order[i]];
+    shuffled_ns +=
+        time_ns([&] { buddy.free_bulk(shuffled.data(), k_count); });
+  }
+  report("malloc_bulk" + suffix, alloc_ns, k_rounds * k_count);
+  report("free_bulk en orden" + suffix, free_ns, k_rounds * k_count);
+  report("free_bulk barajado" + suffix, shuffled_ns, k_rounds * k_count);
+}
+
+} // namespace
+
+int main() {
+  for (size_t size : {64, 4096})
+    run(size);
+  return 0;
+}
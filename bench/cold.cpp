@@ -0,0 +1,70 @@
+#include "../head/buddy.h"
+#include "../head/vmem.h"
+#include "bench.h"
+#include <cstring>
+#include <vector>
+
+// Memoria libre fria: listas dentro de los bloques libres frente a
+// Buddy_options::bitmap_only, en un heap de 1 GB que devuelve al sistema
+// los bloques libres de 64 KB o mas (release_size).
+// Con listas cada bloque libre conserva comprometida la pagina de su
+// ListNode, y cada split escribe en la mitad derecha aunque nadie la pida.
+// Con bitmap_only el bloque libre se devuelve entero y no se vuelve a tocar.
+// Se reservan y rellenan bloques de 16 KB .. 1 MB, se liberan 7 de cada 8 y
+// se mide la parte residente del heap y el coste de malloc/free despues.
+
+namespace {
+
+using Big_buddy = Buddy_allocation<size_t(1) << 30>;
+
+constexpr size_t k_blocks = 2000;
+constexpr size_t k_rounds = 1000000;
+
+size_t block_size(Xorshift &rng) { return size_t(16 * 1024) << rng.next() % 7; }
+
+void run(const char *label, const Buddy_options &options) {
+  static std::vector<void *> live(k_blocks);
+  Big_buddy *buddy = new Big_buddy(options);
+
+  Xorshift rng;
+  size_t kept = 0;
+  for (size_t i = 0; i < k_blocks; ++i) {
+    const size_t size = block_size(rng);
+    live[i] = buddy->malloc(size);
+    std::memset(live[i], 1, size);
+    kept += i % 8 ? 0 : size;
+  }
+  for (size_t i = 0; i < k_blocks; ++i)
+    if (i % 8)
+      buddy->free(live[i]);
+  const size_t resident =
+      vmem::resident_bytes(buddy->heap_base, Big_buddy::k_size);
+
+  const double ns = time_ns([&] {
+    for (size_t i = 0; i < k_rounds; ++i) {
+      void *ptr = buddy->malloc(size_t(64) << rng.next() % 10);
+      do_not_optimize(ptr);
+      buddy->free(ptr);
+    }
+  });
+
+  report(label, ns, 2 * k_rounds);
+  std::cout << "  heap residente: " << resident / 1024 << " KB ("
+            << kept / 1024 << " KB vivos)\n";
+  for (size_t i = 0; i < k_blocks; i += 8)
+    buddy->free(live[i]);
+  delete buddy;
+}
+
+} // namespace
+
+int main() {
+  Buddy_options options;
+  options.release_size = 64 * 1024;
+  run("Listas (lifo)", options);
+  options.placement = Buddy_placement::lowest_address;
+  run("Listas + mapas de bits", options);
+  options.bitmap_only = true;
+  run("Solo mapas de bits", options);
+  return 0;
+}
@@ -0,0 +1,63 @@
+#include "../head/buddy.h"
+#include "../head/lfbuddy.h"
+#include "bench.h"
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+// Contencion maxima: todos los hilos piden y liberan bloques del mismo
+// tamano con una ventana minima de bloques vivos, asi que compiten siempre
+// por el mismo orden (el mismo cerrojo en Concurrent_buddy, los mismos
+// ancestros en Lockfree_buddy).
+// Se mide el rendimiento total y el heap debe quedar vacio al final.
+
+namespace {
+
+constexpr size_t k_ops_per_thread = 400000;
+constexpr size_t k_window = 4;
+
+template <class Heap> void worker(Heap &heap, size_t size, uint64_t seed) {
+  Xorshift rng;
+  rng.state += seed * 0x2545F4914F6CDD1Dull;
+  void *live[k_window] = {};
+  for (size_t i = 0; i < k_ops_per_thread; ++i) {
+    const size_t slot = rng.next() % k_window;
+    heap.free(live[slot]);
+    live[slot] = heap.malloc(size);
+  }
+  for (void *ptr : live)
+    heap.free(ptr);
+}
+
+template <class Heap>
+void run(const char *label, size_t size, size_t max_threads) {
+  static Heap heap;
+  worker(heap, size, 0);
+  std::cout << label << " (" << size << " B)\n";
+  for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+    std::vector<std::thread> pool;
+    const double ns = time_ns([&] {
+      for (size_t t = 0; t < threads; ++t)
+        pool.emplace_back([&, t] { worker(heap, size, t + 1); });
+      for (auto &thread : pool)
+        thread.join();
+    });
+    const size_t ops = 2 * threads * k_ops_per_thread;
+    std::cout << "  " << threads << " hilos: " << std::fixed
+              << std::setprecision(2) << ops / ns * 1000 << " Mops/s"
+              << (heap.empty() ? "" : "  (heap no vacio!)") << "\n";
+  }
+}
+
+} // namespace
+
+int main() {
+  const size_t max_threads =
+      std::max<size_t>(4, std::thread::hardware_concurrency());
+  std::cout << "CPUs: " << std::thread::hardware_concurrency() << "\n";
+  for (size_t size : {64, 64 * 1024}) {
+    run<Concurrent_buddy>("Cerrojo por orden", size, max_threads);
+    run<Default_lockfree_buddy>("Sin cerrojos", size, max_threads);
+  }
+  return 0;
+}
@@ -0,0 +1,61 @@
+#include "../head/buddy.h"
+#include "bench.h"
+#include <vector>
+
+// Reserva exacta (malloc_exact) frente a bloques potencia de 2 (malloc) con
+// tamanos de textura: lado 64 .. 1024 px no necesariamente potencia de 2,
+// 3 o 4 canales. Se llena el heap con la misma secuencia de texturas hasta
+// el primer fallo y se mide:
+//   - texturas que caben y fragmentacion interna (1 - pedido / asignado)
+//   - coste de una pareja malloc/free con el heap vacio
+
+namespace {
+
+template <bool Exact> void fill(const std::vector<size_t> &sizes) {
+  static Default_buddy buddy;
+  std::vector<void *> live;
+  size_t requested = 0, allocated = 0;
+  for (size_t size : sizes) {
+    void *ptr = Exact ? buddy.malloc_exact(size) : buddy.malloc(size);
+    if (!ptr)
+      break;
+    live.push_back(ptr);
+    requested += size;
+    allocated += Exact ? (size + Min_alloc - 1) & ~(Min_alloc - 1)
+                       : buddy.usable_size(ptr);
+  }
+  std::cout << (Exact ? "malloc_exact" : "malloc      ") << ": "
+            << live.size() << " texturas, " << std::fixed
+            << std::setprecision(1) << 100.0 * (allocated - requested) / allocated
+            << "% fragmentacion interna\n";
+  for (size_t i = 0; i < live.size(); ++i) {
+    if (Exact)
+      buddy.free_exact(live[i], sizes[i]);
+    else
+      buddy.free(live[i], sizes[i]);
+  }
+
+  const size_t rounds = 100000;
+  const double ns = time_ns([&] {
+    for (size_t i = 0; i < rounds; ++i) {
+      const size_t size = sizes[i % sizes.size()];
+      void *ptr = Exact ? buddy.malloc_exact(size) : buddy.malloc(size);
+      do_not_optimize(ptr);
+      if (Exact)
+        buddy.free_exact(ptr, size);
+      else
+        buddy.free(ptr, size);
+    }
+  });
+  report(Exact ? "  malloc_exact + free_exact" : "  malloc + free(ptr, size)", ns,
+         rounds);
+}
+
+} // namespace
+
+int main() {
+  const std::vector<size_t> sizes = texture_sizes();
+  fill<false>(sizes);
+  fill<true>(sizes);
+  return 0;
+}
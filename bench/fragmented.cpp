@@ -0,0 +1,53 @@
+#include "../head/buddy.h"
+#include "bench.h"
+#include <vector>
+
+// Busqueda de bloque libre sobre un heap fragmentado: se reserva el heap
+// entero en bloques de 4 KB y se libera uno de cada dos, de modo que solo
+// quedan libres bloques de orden 8 (sin posibilidad de coalescer).
+// Las peticiones mayores fallan recorriendo todos los ordenes superiores y
+// las pequenas deben encontrar el orden 8 partiendo desde el orden 0.
+
+int main() {
+  constexpr size_t k_page = 4096;
+  constexpr size_t k_rounds = 1000000;
+  static Default_buddy buddy;
+
+  std::vector<void *> pages;
+  while (void *p = buddy.malloc(k_page))
+    pages.push_back(p);
+  for (size_t i = 0; i < pages.size(); i += 2)
+    buddy.free(pages[i]);
+
+  std::cout << "Heap fragmentado: " << pages.size() / 2
+            << " bloques libres de " << k_page << " bytes\n";
+
+  // Fallos: ningun orden >= 9 tiene bloques libres
+  double ns = time_ns([&] {
+    for (size_t i = 0; i < k_rounds; ++i)
+      do_not_optimize(buddy.malloc(2 * k_page));
+  });
+  report("malloc fallido (8 KB)", ns, k_rounds);
+
+  // Aciertos pequenos: el unico orden con bloques es el 8
+  ns = time_ns([&] {
+    for (size_t i = 0; i < k_rounds; ++i) {
+      void *p = buddy.malloc(k_page);
+      do_not_optimize(p);
+      buddy.free(p);
+    }
+  });
+  report("malloc+free (4 KB)", ns, k_rounds);
+
+  // Mezcla de tamanos 16 B .. 4 KB (parte y vuelve a unir)
+  Xorshift rng;
+  ns = time_ns([&] {
+    for (size_t i = 0; i < k_rounds; ++i) {
+      void *p = buddy.malloc(16 << (rng.next() % 9));
+      do_not_optimize(p);
+      buddy.free(p);
+    }
+  });
+  report("malloc+free (16 B .. 4 KB)", ns, k_rounds);
+  return 0;
+}
@@ -0,0 +1,76 @@
+#include "../head/buddy.h"
+#include "bench.h"
+#include <vector>
+
+// Patron por frame: cada frame reserva los mismos buffers temporales
+// (constantes, listas de dibujado, staging de 64 B .. 64 KB) y los libera
+// todos al final. Con coalescencia inmediata cada free sube uniendo
+// hermanos y el malloc del frame siguiente vuelve a partirlos; en modo
+// perezoso (Buddy_options::lazy_slack) los bloques esperan en su orden.
+// Hay ademas bloques de vida larga repartidos por el heap para que los
+// temporales no coalescan siempre hasta la raiz.
+
+namespace {
+
+constexpr size_t k_frames = 2000;
+constexpr size_t k_per_frame = 256;
+constexpr size_t k_resident = 512;
+
+std::vector<size_t> frame_sizes() {
+  Xorshift rng;
+  std::vector<size_t> sizes;
+  for (size_t i = 0; i < k_per_frame; ++i) {
+    const uint64_t r = rng.next();
+    sizes.push_back((size_t(64) << (r >> 8) % 11) - (r >> 32) % 32);
+  }
+  return sizes;
+}
+
+void run(const char *label, size_t slack) {
+  Buddy_options options;
+  options.lazy_slack = slack;
+  Default_buddy buddy(options);
+
+  Xorshift rng;
+  std::vector<void *> resident;
+  for (size_t i = 0; i < k_resident; ++i)
+    resident.push_back(buddy.malloc(size_t(256) << rng.next() % 8));
+
+  const std::vector<size_t> sizes = frame_sizes();
+  std::vector<void *> live(sizes.size());
+  const auto frame = [&] {
+    for (size_t i = 0; i < sizes.size(); ++i)
+      live[i] = buddy.malloc(sizes[i]);
+    for (void *ptr : live)
+      buddy.free(ptr);
+  };
+  frame(); // calentamiento
+  const Coalesce_stats before = buddy.coalesce_stats();
+  const double ns = time_ns([&] {
+    for (size_t f = 0; f < k_frames; ++f)
+      frame();
+  });
+  const Coalesce_stats after = buddy.coalesce_stats();
+
+  report(label, ns, 2 * k_frames * k_per_frame);
+  std::cout << "  por frame: " << std::fixed << std::setprecision(1)
+            << double(after.splits - before.splits) / k_frames << " splits, "
+            << double(after.merges - before.merges) / k_frames << " merges, "
+            << double(after.reused - before.reused) / k_frames
+            << " reutilizados\n";
+
+  for (void *ptr : resident)
+    buddy.free(ptr);
+  buddy.flush();
+  if (!buddy.empty())
+    std::cout << "  (heap no vacio!)\n";
+}
+
+} // namespace
+
+int main() {
+  run("Coalescencia inmediata", 0);
+  run("Perezosa, margen 16 por orden", 16);
+  run("Perezosa, margen 64 por orden", 64);
+  return 0;
+}
@@ -0,0 +1,73 @@
+#include "../head/buddy.h"
+#include "bench.h"
+#include <cstring>
+
+// Copias con muchos fallos de TLB sobre un bloque de 32 MB del heap buddy,
+// con paginas base y con paginas de 2 MB (MAP_HUGETLB o THP).
+// - "aleatoria": copia lineas de 64 B entre paginas elegidas al azar, cada
+//   acceso cae en una pagina distinta (peor caso para el TLB)
+// - "secuencial": memcpy de la mitad del bloque sobre la otra mitad
+// Si se piden paginas grandes y el pool de hugetlb (vm.nr_hugepages) no
+// tiene las del heap, el heap recurre a THP y se indica en la salida.
+
+static const char *backing_name(vmem::Backing backing) {
+  switch (backing) {
+  case vmem::Backing::explicit_huge:
+    return "MAP_HUGETLB";
+  case vmem::Backing::transparent_huge:
+    return "THP (MADV_HUGEPAGE)";
+  default:
+    return "paginas base";
+  }
+}
+
+static void run(const char *label, const Buddy_options &options) {
+  constexpr size_t k_block = 32 * 1024 * 1024;
+  constexpr size_t k_half = k_block / 2;
+  constexpr size_t k_line = 64;
+  constexpr size_t k_copies = 4000000;
+  constexpr size_t k_rounds = 20;
+
+  Default_buddy buddy(options);
+  char *block = static_cast<char *>(buddy.malloc(k_block));
+  memset(block, 1, k_block); // compromete todas las paginas antes de medir
+
+  std::cout << label << ": " << backing_name(buddy.backing()) << "\n";
+  if (options.huge_pages && buddy.backing() != vmem::Backing::explicit_huge)
+    std::cout << "  sin MAP_HUGETLB: el pool no tiene "
+              << Default_buddy::k_size / vmem::k_huge_page
+              << " paginas de 2 MB libres\n";
+
+  Xorshift rng;
+  double ns = time_ns([&] {
+    for (size_t i = 0; i < k_copies; ++i) {
+      const uint64_t r = rng.next();
+      const size_t src = (r % (k_half / k_line)) * k_line;
+      const size_t dst = k_half + ((r >> 32) % (k_half / k_line)) * k_line;
+      memcpy(block + dst, block + src, k_line);
+    }
+  });
+  do_not_optimize(block);
+  report("  copia aleatoria de 64 B", ns, k_copies);
+  std::cout << "  " << std::setprecision(2) << k_copies * k_line / ns
+            << " GB/s\n";
+
+  ns = time_ns([&] {
+    for (size_t i = 0; i < k_rounds; ++i) {
+      memcpy(block + k_half, block, k_half);
+      do_not_optimize(block);
+    }
+  });
+  std::cout << "  copia secuencial de 16 MB: " << k_rounds * k_half / ns
+            << " GB/s\n";
+  buddy.free(block);
+}
+
+int main() {
+  Buddy_options base;
+  Buddy_options huge;
+  huge.huge_pages = true;
+  run("Heap normal", base);
+  run("Heap con paginas grandes", huge);
+  return 0;
+}
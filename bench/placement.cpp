@@ -0,0 +1,104 @@
+#include "../head/buddy.h"
+#include "bench.h"
+#include <algorithm>
+#include <vector>
+
+// Fragmentacion segun la politica de colocacion sobre una misma traza.
+// La traza mezcla peticiones de vida corta (16 B .. 16 KB, unos cientos de
+// eventos) con texturas de vida larga (64 KB .. 2 MB, decenas de miles de
+// eventos) y se reproduce igual con Buddy_placement::lifo y lowest_address.
+// Al final de la traza (sin liberar lo vivo) se mide:
+//   - mayor bloque libre y fragmentacion externa: 1 - mayor / libre total
+//   - extension: bytes desde la base hasta el final del ultimo bloque vivo
+
+namespace {
+
+constexpr size_t k_events = 400000;
+
+struct Event {
+  size_t size; // 0 = liberar
+  size_t slot; // indice del bloque en la tabla de vivos
+};
+
+std::vector<Event> make_trace(size_t &slots) {
+  Xorshift rng;
+  std::vector<Event> trace;
+  // muertes programadas: (evento, slot)
+  std::vector<std::pair<size_t, size_t>> deaths;
+  slots = 0;
+  for (size_t now = 0; now < k_events; ++now) {
+    const uint64_t r = rng.next();
+    size_t size, lifetime;
+    if (r % 500 == 0) {
+      size = size_t(64 * 1024) << (r >> 16) % 6;
+      lifetime = 5000 + (r >> 32) % 40000;
+    } else {
+      size = size_t(16) << (r >> 16) % 11;
+      lifetime = 1 + (r >> 32) % 300;
+    }
+    trace.push_back({size, slots});
+    deaths.push_back({now + lifetime, slots++});
+    std::push_heap(deaths.begin(), deaths.end(), std::greater<>());
+    while (!deaths.empty() && deaths.front().first <= now) {
+      trace.push_back({0, deaths.front().second});
+      std::pop_heap(deaths.begin(), deaths.end(), std::greater<>());
+      deaths.pop_back();
+    }
+  }
+  return trace;
+}
+
+void replay(const char *label, Buddy_placement placement,
+            const std::vector<Event> &trace, size_t slots) {
+  Buddy_options options;
+  options.placement = placement;
+  Default_buddy buddy(options);
+  std::vector<void *> live(slots, nullptr);
+  size_t failures = 0;
+
+  const double ns = time_ns([&] {
+    for (const Event &event : trace) {
+      if (event.size) {
+        live[event.slot] = buddy.malloc(event.size);
+        failures += !live[event.slot];
+      } else {
+        buddy.free(live[event.slot]);
+        live[event.slot] = nullptr;
+      }
+    }
+  });
+
+  size_t used = 0, extent = 0;
+  for (void *ptr : live) {
+    if (!ptr)
+      continue;
+    const size_t size = buddy.usable_size(ptr);
+    used += size;
+    extent = std::max<size_t>(extent,
+                              static_cast<char *>(ptr) - buddy.heap_base + size);
+  }
+  const size_t free_bytes = Default_buddy::k_size - used;
+  const size_t largest = buddy.largest_free_block();
+
+  std::cout << label << "\n";
+  report("  malloc/free", ns, trace.size());
+  std::cout << std::fixed << std::setprecision(2)
+            << "  vivos: " << used / 1024 << " KB, fallos: " << failures
+            << "\n  mayor libre: " << largest / 1024 << " KB de "
+            << free_bytes / 1024 << " KB (fragmentacion externa "
+            << 100.0 * (1 - double(largest) / free_bytes) << "%)"
+            << "\n  extension: " << extent / 1024 << " KB\n";
+
+  for (void *ptr : live)
+    buddy.free(ptr);
+}
+
+} // namespace
+
+int main() {
+  size_t slots = 0;
+  const std::vector<Event> trace = make_trace(slots);
+  replay("LIFO", Buddy_placement::lifo, trace, slots);
+  replay("Menor direccion", Buddy_placement::lowest_address, trace, slots);
+  return 0;
+}
@@ -0,0 +1,74 @@
+#include "../head/buddy.h"
+#include "bench.h"
+#include <cstring>
+
+// Buffers que crecen por duplicacion (vertex buffers, texturas en streaming)
+// de 1 KB a 1 MB, con un bloque pequeno reservado entre crecimiento y
+// crecimiento para que el hermano derecho no siempre este libre.
+// realloc frente a malloc + memcpy + free; al final se imprime cuantas
+// veces se evito la copia.
+// Despues, con release_size, se encoge en sitio un buffer de 32 MB ya
+// escrito a 64 KB: las mitades derechas deben devolver sus paginas como un
+// free normal.
+
+namespace {
+
+constexpr size_t k_rounds = 2000;
+constexpr size_t k_start = 1024;
+constexpr size_t k_limit = 1024 * 1024;
+
+template <typename Grow> double run(Default_buddy &buddy, Grow grow) {
+  return time_ns([&] {
+    for (size_t round = 0; round < k_rounds; ++round) {
+      void *buffer = buddy.malloc(k_start);
+      void *noise[16] = {};
+      size_t count = 0;
+      for (size_t size = k_start; size < k_limit; size *= 2) {
+        buffer = grow(buffer, size, size * 2);
+        if (count < 16 && round % 2)
+          noise[count++] = buddy.malloc(64);
+      }
+      do_not_optimize(buffer);
+      buddy.free(buffer);
+      for (size_t i = 0; i < count; ++i)
+        buddy.free(noise[i]);
+    }
+  });
+}
+
+} // namespace
+
+int main() {
+  static Default_buddy buddy;
+  const size_t grows = k_rounds * (log2(k_limit) - log2(k_start));
+
+  double ns = run(buddy, [&](void *ptr, size_t old_size, size_t size) {
+    void *moved = buddy.malloc(size);
+    std::memcpy(moved, ptr, old_size);
+    buddy.free(ptr);
+    return moved;
+  });
+  report("malloc + memcpy + free", ns, grows);
+
+  ns = run(buddy, [&](void *ptr, size_t, size_t size) {
+    return buddy.realloc(ptr, size);
+  });
+  report("realloc", ns, grows);
+
+  const Realloc_stats stats = buddy.realloc_stats();
+  std::cout << "Crecimientos en sitio: " << stats.grown_in_place
+            << ", copias: " << stats.moved << "\n";
+
+  Buddy_options options;
+  options.release_size = 1024 * 1024;
+  static Default_buddy releasing(options);
+  void *buffer = releasing.malloc(32 * 1024 * 1024);
+  std::memset(buffer, 1, 32 * 1024 * 1024);
+  const size_t before = releasing.resident_bytes();
+  buffer = releasing.realloc(buffer, 64 * 1024);
+  std::cout << "Encoger 32 MB a 64 KB: residente " << before / 1024 << " -> "
+            << releasing.resident_bytes() / 1024 << " KB, devuelto SO "
+            << releasing.released_bytes() / 1024 << " KB\n";
+  releasing.free(buffer);
+  return 0;
+}
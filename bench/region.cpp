@@ -0,0 +1,75 @@
+#include "../head/buddy.h"
+#include "../head/vmem.h"
+#include "bench.h"
+#include <cstring>
+#include <vector>
+
+// Heap sobre una region del llamador de tamano arbitrario (10.000.123 bytes,
+// como una zona de staging que no es potencia de 2), frente a gestionar solo
+// la mayor potencia de 2 que cabe en ella (8 MB).
+// La region se llena de bloques de 4 KB .. 64 KB hasta el primer fallo, se
+// rellena cada bloque y se comprueba su contenido; despues se libera todo y
+// se mide una pareja malloc/free. release_size se pide a proposito: sobre
+// una region ajena no debe descartar nada.
+
+namespace {
+
+constexpr size_t k_length = 10000123;
+constexpr size_t k_rounds = 1000000;
+
+using Region_buddy = Buddy_allocation<16 * 1024 * 1024>;
+
+void run(const char *label, char *base, size_t length) {
+  Buddy_options options;
+  options.release_size = 64 * 1024;
+  Region_buddy buddy(base, length, options);
+
+  Xorshift rng;
+  std::vector<std::pair<unsigned char *, size_t>> live;
+  size_t used = 0;
+  for (;;) {
+    const size_t size = size_t(4096) << rng.next() % 5;
+    auto ptr = static_cast<unsigned char *>(buddy.malloc(size));
+    if (!ptr)
+      break;
+    std::memset(ptr, static_cast<int>(live.size()), size);
+    live.emplace_back(ptr, size);
+    used += size;
+  }
+  size_t bad = 0;
+  for (size_t i = 0; i < live.size(); ++i) {
+    const auto &block = live[i];
+    bad += block.first < reinterpret_cast<unsigned char *>(base) ||
+           block.first + block.second >
+               reinterpret_cast<unsigned char *>(base) + length ||
+           block.first[block.second - 1] != static_cast<unsigned char>(i);
+  }
+  for (const auto &block : live)
+    buddy.free(block.first);
+
+  const double ns = time_ns([&] {
+    for (size_t i = 0; i < k_rounds; ++i) {
+      void *ptr = buddy.malloc(size_t(64) << rng.next() % 10);
+      do_not_optimize(ptr);
+      buddy.free(ptr);
+    }
+  });
+
+  std::cout << label << ": gestiona " << buddy.managed_bytes() << " de "
+            << length << " bytes, " << live.size() << " bloques ("
+            << used / 1024 << " KB), contenido "
+            << (bad ? "distinto" : "correcto") << ", heap "
+            << (buddy.empty() ? "vacio" : "no vacio!") << ", devuelto SO "
+            << buddy.released_bytes() << "\n";
+  report("  malloc/free", ns, 2 * k_rounds);
+}
+
+} // namespace
+
+int main() {
+  auto region = static_cast<char *>(vmem::reserve(k_length));
+  run("Region completa        ", region, k_length);
+  run("Solo potencia de 2 (8 MB)", region, size_t(8) * 1024 * 1024);
+  vmem::release(region, k_length);
+  return 0;
+}
@@ -0,0 +1,118 @@
+#include "../head/buddy.h"
+#include "../head/lfbuddy.h"
+#include "../head/shard.h"
+#include "../head/tcache.h"
+#include "bench.h"
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Escalado multihilo de malloc/free de 1 a N hilos.
+// Cada hilo mantiene una ventana de bloques vivos y reemplaza uno al azar en
+// cada iteracion; la mitad de las peticiones son pequenas (16 B .. 512 B) y
+// la otra mitad grandes (4 KB .. 256 KB), para que haya hilos trabajando en
+// ordenes distintos a la vez.
+// Se compara el cerrojo por orden (Concurrent_buddy) con un unico mutex
+// global alrededor del heap monohilo, y con las caches por hilo delante del
+// heap concurrente (Buddy_tcache), con el motor sin cerrojos
+// (Lockfree_buddy) y con una arena por CPU (Buddy_shards). Al final se
+// fija cada hilo a una arena con set_thread_shard y se da a todos la misma
+// para ver el coste de compartir frente a repartir.
+
+namespace {
+
+constexpr size_t k_ops_per_thread = 400000;
+constexpr size_t k_window = 64;
+
+struct Global_lock_buddy {
+  Default_buddy buddy;
+  std::mutex lock;
+  void *malloc(size_t size) {
+    std::lock_guard<std::mutex> guard(lock);
+    return buddy.malloc(size);
+  }
+  void free(void *ptr) {
+    std::lock_guard<std::mutex> guard(lock);
+    buddy.free(ptr);
+  }
+};
+
+size_t request_size(Xorshift &rng) {
+  const uint64_t r = rng.next();
+  return (r & 1) ? size_t(16) << (r >> 8) % 6 : size_t(4096) << (r >> 8) % 7;
+}
+
+template <class Heap> void worker(Heap &heap, uint64_t seed) {
+  Xorshift rng;
+  rng.state += seed * 0x2545F4914F6CDD1Dull;
+  void *live[k_window] = {};
+  for (size_t i = 0; i < k_ops_per_thread; ++i) {
+    const size_t slot = rng.next() % k_window;
+    heap.free(live[slot]);
+    live[slot] = heap.malloc(request_size(rng));
+  }
+  for (void *ptr : live)
+    heap.free(ptr);
+}
+
+template <class Heap> void run(const char *label, size_t max_threads) {
+  static Heap heap;
+  worker(heap, 0); // calentamiento: compromete las paginas del heap
+  std::cout << label << "\n";
+  for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+    std::vector<std::thread> pool;
+    const double ns = time_ns([&] {
+      for (size_t t = 0; t < threads; ++t)
+        pool.emplace_back([t] { worker(heap, t + 1); });
+      for (auto &thread : pool)
+        thread.join();
+    });
+    const size_t ops = 2 * threads * k_ops_per_thread;
+    std::cout << "  " << threads << " hilos: " << std::fixed
+              << std::setprecision(2) << ops / ns * 1000 << " Mops/s\n";
+  }
+}
+
+// Buddy_shards con max_threads arenas: cada hilo en la suya o todos en la 0
+void run_pinned(const char *label, size_t max_threads, bool same_shard) {
+  Buddy_shards<> heap(Buddy_options(), max_threads);
+  for (size_t shard = 0; shard < max_threads; ++shard) {
+    Buddy_shards<>::set_thread_shard(shard);
+    worker(heap, 0); // calentamiento de cada arena
+  }
+  Buddy_shards<>::set_thread_shard(Buddy_shards<>::k_any_shard);
+  std::cout << label << "\n";
+  for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+    std::vector<std::thread> pool;
+    const double ns = time_ns([&] {
+      for (size_t t = 0; t < threads; ++t)
+        pool.emplace_back([&heap, t, same_shard] {
+          Buddy_shards<>::set_thread_shard(same_shard ? 0 : t);
+          worker(heap, t + 1);
+        });
+      for (auto &thread : pool)
+        thread.join();
+    });
+    const size_t ops = 2 * threads * k_ops_per_thread;
+    std::cout << "  " << threads << " hilos: " << std::fixed
+              << std::setprecision(2) << ops / ns * 1000 << " Mops/s\n";
+  }
+  std::cout << "  robos entre arenas: " << heap.steals() << "\n";
+}
+
+} // namespace
+
+int main() {
+  const size_t max_threads =
+      std::max<size_t>(4, std::thread::hardware_concurrency());
+  std::cout << "CPUs: " << std::thread::hardware_concurrency() << "\n";
+  run<Global_lock_buddy>("Mutex global", max_threads);
+  run<Concurrent_buddy>("Cerrojo por orden", max_threads);
+  run<Buddy_tcache<>>("Cache por hilo + cerrojo por orden", max_threads);
+  run<Default_lockfree_buddy>("Sin cerrojos (arbol de estados)", max_threads);
+  run<Buddy_shards<>>("Arena por CPU (sched_getcpu)", max_threads);
+  run_pinned("Arena por hilo (set_thread_shard)", max_threads, false);
+  run_pinned("Todos los hilos en la misma arena", max_threads, true);
+  return 0;
+}
@@ -0,0 +1,209 @@
+#include "../head/shmbuddy.h"
+#include "bench.h"
+#include <algorithm>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+// Heap compartido entre un proceso cargador y un proceso de render.
+// El cargador (hijo) se une al segmento con el descriptor heredado, reserva
+// texturas de 64 KB .. 1 MB, las rellena y envia por una tuberia solo su
+// desplazamiento y tamano. El render (padre) las lee en su propia
+// proyeccion del heap, comprueba el contenido y las libera.
+// Cuando el heap esta lleno el cargador espera en una segunda tuberia a que
+// el render avise de que libero una textura (sin sondear con sleeps).
+// Se compara con enviar los mismos bytes por la tuberia (una copia de ida y
+// otra de vuelta) desde un unico buffer privado reutilizado. Cada variante
+// se ejecuta k_runs veces alternando el orden y se da la mediana: la
+// primera ejecucion de cada una paga los fallos de pagina del segmento y
+// del buffer. Al final los dos procesos hacen malloc/free a la vez sobre
+// el mismo heap.
+
+namespace {
+
+constexpr size_t k_textures = 512;
+constexpr size_t k_churn_ops = 400000;
+constexpr size_t k_runs = 5;
+
+struct Message {
+  uint64_t offset;
+  uint64_t size;
+};
+
+size_t texture_size(size_t i) { return (size_t(64 * 1024) << i % 5) - i; }
+constexpr size_t k_max_texture = size_t(64 * 1024) << 4;
+
+unsigned char pattern(size_t i, size_t byte) {
+  return static_cast<unsigned char>(byte * 7 + i);
+}
+
+bool write_all(int fd, const void *data, size_t size) {
+  auto bytes = static_cast<const char *>(data);
+  while (size) {
+    const ssize_t done = write(fd, bytes, size);
+    if (done <= 0)
+      return false;
+    bytes += done;
+    size -= done;
+  }
+  return true;
+}
+
+bool read_all(int fd, void *data, size_t size) {
+  auto bytes = static_cast<char *>(data);
+  while (size) {
+    const ssize_t done = read(fd, bytes, size);
+    if (done <= 0)
+      return false;
+    bytes += done;
+    size -= done;
+  }
+  return true;
+}
+
+void churn(Default_shared_buddy &heap, uint64_t seed) {
+  Xorshift rng;
+  rng.state += seed * 0x2545F4914F6CDD1Dull;
+  void *live[64] = {};
+  for (size_t i = 0; i < k_churn_ops; ++i) {
+    const size_t slot = rng.next() % 64;
+    heap.free(live[slot]);
+    live[slot] = heap.malloc(size_t(16) << rng.next() % 10);
+  }
+  for (void *ptr : live)
+    heap.free(ptr);
+}
+
+// Hijo: carga las texturas en el heap compartido y envia desplazamientos.
+// Cada byte de freed es una textura que el render ya libero.
+void loader(int fd, int out, int freed) {
+  Default_shared_buddy heap(fd);
+  for (size_t i = 0; i < k_textures; ++i) {
+    const size_t size = texture_size(i);
+    auto ptr = static_cast<unsigned char *>(heap.malloc(size));
+    char token;
+    while (!ptr && read(freed, &token, 1) == 1)
+      ptr = static_cast<unsigned char *>(heap.malloc(size));
+    if (!ptr)
+      return;
+    for (size_t b = 0; b < size; ++b)
+      ptr[b] = pattern(i, b);
+    const Message message = {heap.offset_of(ptr), size};
+    write_all(out, &message, sizeof(message));
+  }
+}
+
+// Hijo: carga las mismas texturas en memoria privada y envia los bytes
+void copying_loader(int out, int) {
+  std::vector<unsigned char> texture(k_max_texture);
+  for (size_t i = 0; i < k_textures; ++i) {
+    const size_t size = texture_size(i);
+    for (size_t b = 0; b < size; ++b)
+      texture[b] = pattern(i, b);
+    write_all(out, &size, sizeof(size));
+    write_all(out, texture.data(), size);
+  }
+}
+
+// child(out, back) escribe en out y lee de back; parent(in, back) al reves
+template <typename Child, typename Parent>
+double run_pair(Child &&child, Parent &&parent) {
+  int data[2], back[2];
+  if (pipe(data) != 0)
+    return 0;
+  if (pipe(back) != 0) {
+    close(data[0]);
+    close(data[1]);
+    return 0;
+  }
+  return time_ns([&] {
+    const pid_t pid = fork();
+    if (pid == 0) {
+      close(data[0]);
+      close(back[1]);
+      child(data[1], back[0]);
+      close(data[1]);
+      close(back[0]);
+      _exit(0);
+    }
+    close(data[1]);
+    close(back[0]);
+    parent(data[0], back[1]);
+    close(data[0]);
+    close(back[1]);
+    waitpid(pid, nullptr, 0);
+  });
+}
+
+double median(std::vector<double> samples) {
+  std::sort(samples.begin(), samples.end());
+  return samples[samples.size() / 2];
+}
+
+} // namespace
+
+int main() {
+  Default_shared_buddy heap;
+  size_t bad = 0, bytes = 0, received = 0;
+
+  const auto shared_run = [&] {
+    return run_pair(
+        [&](int out, int freed) { loader(heap.fd(), out, freed); },
+        [&](int in, int freed) {
+          Message message;
+          bytes = 0;
+          for (size_t i = 0; read_all(in, &message, sizeof(message)); ++i) {
+            auto ptr = static_cast<unsigned char *>(heap.at(message.offset));
+            for (size_t b = 0; b < message.size; b += 4096)
+              bad += ptr[b] != pattern(i, b);
+            bytes += message.size;
+            heap.free(ptr, message.size);
+            write_all(freed, "", 1);
+            ++received;
+          }
+        });
+  };
+  const auto copy_run = [&] {
+    return run_pair(copying_loader, [&](int in, int) {
+      std::vector<unsigned char> texture(k_max_texture);
+      size_t size;
+      for (size_t i = 0; read_all(in, &size, sizeof(size)); ++i) {
+        read_all(in, texture.data(), size);
+        for (size_t b = 0; b < size; b += 4096)
+          bad += texture[b] != pattern(i, b);
+        ++received;
+      }
+    });
+  };
+
+  std::vector<double> shared_runs, copy_runs;
+  for (size_t run = 0; run < k_runs; ++run) {
+    if (run % 2) {
+      copy_runs.push_back(copy_run());
+      shared_runs.push_back(shared_run());
+    } else {
+      shared_runs.push_back(shared_run());
+      copy_runs.push_back(copy_run());
+    }
+  }
+  const double shared_ns = median(shared_runs);
+  const double copy_ns = median(copy_runs);
+  bad += received != 2 * k_runs * k_textures;
+
+  std::cout << k_textures << " texturas (" << bytes / (1024 * 1024)
+            << " MB) de un proceso a otro, mediana de " << k_runs
+            << " ejecuciones\n"
+            << std::fixed << std::setprecision(2);
+  std::cout << "  heap compartido (desplazamientos): " << shared_ns / 1e6
+            << " ms\n";
+  std::cout << "  copia por tuberia:                 " << copy_ns / 1e6
+            << " ms\n";
+
+  // Dos procesos compitiendo por el mismo arbol de estados
+  const double churn_ns = run_pair([&](int, int) { churn(heap, 1); },
+                                   [&](int, int) { churn(heap, 2); });
+  report("malloc/free desde 2 procesos", churn_ns, 4 * k_churn_ops);
+  std::cout << "  contenido " << (bad ? "distinto" : "correcto") << ", heap "
+            << (heap.empty() ? "vacio" : "no vacio!") << "\n";
+  return 0;
+}
@@ -0,0 +1,137 @@
+#include "../head/buddy.h"
+#include "bench.h"
+#include <cstdio>
+#include <vector>
+
+// Arranque en caliente con save/restore frente a reconstruir el heap.
+// La "carga de nivel" reserva texturas de 16 KB .. 1 MB y las rellena
+// byte a byte (como si se decodificaran) hasta ocupar unos 40 MB, entre
+// bloques pequenos que se liberan para dejar listas libres largas.
+// Se mide: reconstruir, guardar la instantanea, restaurarla en otro heap
+// (otra base) y tocar todo su contenido tras restaurar. Despues se
+// comprueba el contenido y que el heap restaurado sigue funcionando.
+// Por ultimo se restaura en un heap con release_size, se libera todo y se
+// comprueba que las paginas devueltas vuelven a cero y no con el contenido
+// de la instantanea.
+
+namespace {
+
+struct Resource {
+  unsigned char *ptr;
+  size_t size;
+};
+
+std::vector<Resource> load_level(Default_buddy &buddy) {
+  Xorshift rng;
+  std::vector<Resource> resources;
+  std::vector<void *> scratch;
+  size_t total = 0;
+  while (total < 40 * 1024 * 1024) {
+    const uint64_t r = rng.next();
+    const size_t size = (size_t(16 * 1024) << (r >> 8) % 7) - (r >> 32) % 4096;
+    auto ptr = static_cast<unsigned char *>(buddy.malloc(size));
+    if (!ptr)
+      break;
+    for (size_t i = 0; i < size; ++i)
+      ptr[i] = static_cast<unsigned char>(i * 31 + size);
+    resources.push_back({ptr, size});
+    total += size;
+    for (size_t i = 0; i < 16; ++i)
+      scratch.push_back(buddy.malloc(size_t(64) << rng.next() % 6));
+  }
+  for (size_t i = 0; i < scratch.size(); i += 2)
+    buddy.free(scratch[i]);
+  return resources;
+}
+
+bool check(const Resource &resource, const unsigned char *ptr) {
+  for (size_t i = 0; i < resource.size; ++i)
+    if (ptr[i] != static_cast<unsigned char>(i * 31 + resource.size))
+      return false;
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const char *path = argc > 1 ? argv[1] : "buddy.snapshot";
+  static Default_buddy original;
+  static Default_buddy restored;
+
+  std::vector<Resource> resources;
+  const double build = time_ns([&] { resources = load_level(original); });
+  bool saved = false;
+  const double save = time_ns([&] { saved = original.save(path); });
+  bool loaded = false;
+  const double restore = time_ns([&] { loaded = restored.restore(path); });
+  if (!saved || !loaded) {
+    std::cout << "Error al guardar o restaurar " << path << "\n";
+    return 1;
+  }
+
+  // Mismo desplazamiento desde la base en el heap restaurado
+  const auto moved = [&](const void *ptr) {
+    return reinterpret_cast<unsigned char *>(
+        restored.heap_base +
+        (static_cast<const char *>(ptr) - original.heap_base));
+  };
+  size_t sum = 0;
+  const double touch = time_ns([&] {
+    for (const Resource &resource : resources)
+      for (size_t i = 0; i < resource.size; i += 4096)
+        sum += moved(resource.ptr)[i];
+  });
+  do_not_optimize(&sum);
+
+  std::cout << resources.size() << " texturas\n" << std::fixed
+            << std::setprecision(2);
+  std::cout << "  reconstruir:              " << build / 1e6 << " ms\n";
+  std::cout << "  save:                     " << save / 1e6 << " ms\n";
+  std::cout << "  restore:                  " << restore / 1e6 << " ms\n";
+  std::cout << "  restore + tocar el nivel: " << (restore + touch) / 1e6
+            << " ms\n";
+
+  size_t bad = 0;
+  for (const Resource &resource : resources)
+    bad += !check(resource, moved(resource.ptr));
+  // El heap restaurado se puede seguir usando y vaciar por completo
+  std::vector<void *> extra;
+  for (void *ptr; (ptr = restored.malloc(4096));)
+    extra.push_back(ptr);
+  for (void *ptr : extra)
+    restored.free(ptr);
+  for (const Resource &resource : resources)
+    restored.free(moved(resource.ptr));
+  for (const Resource &resource : resources)
+    original.free(resource.ptr);
+  std::cout << "  contenido " << (bad ? "distinto" : "identico")
+            << ", bloques extra: " << extra.size() << "\n";
+
+  Buddy_options options;
+  options.release_size = 1024 * 1024;
+  static Default_buddy releasing(options);
+  if (!releasing.restore(path)) {
+    std::cout << "Error al restaurar " << path << " con release_size\n";
+    return 1;
+  }
+  // Las texturas de 1 MB ocupan bloques de al menos release_size: al
+  // liberarlas se devuelve todo salvo la pagina con el ListNode
+  size_t stale = 0, checked = 0;
+  for (const Resource &resource : resources) {
+    auto ptr = reinterpret_cast<unsigned char *>(
+        releasing.heap_base +
+        (reinterpret_cast<char *>(resource.ptr) - original.heap_base));
+    if (releasing.usable_size(ptr) < options.release_size)
+      continue;
+    releasing.free(ptr);
+    for (size_t i = 4096; i < options.release_size; ++i)
+      stale += ptr[i] != 0;
+    ++checked;
+  }
+  std::cout << "  release_size tras restore: " << checked
+            << " bloques devueltos (" << releasing.released_bytes() / 1024
+            << " KB), " << (stale ? "con datos de la instantanea!" : "a cero")
+            << "\n";
+  std::remove(path);
+  return 0;
+}
@@ -0,0 +1,119 @@
+#include "../head/buddy.h"
+#include "../head/tlsf.h"
+#include "bench.h"
+#include <algorithm>
+#include <vector>
+
+// TLSF frente al buddy binario en una carga de frame: 512 huecos vivos y en
+// cada paso se libera uno al azar y se reserva otro. 7 de cada 8 reservas
+// son buffers de 64 B .. 8 KB y el resto texturas de 16 KB .. 1 MB, ninguna
+// de tamano potencia de 2.
+//   - latencia de cada malloc y cada free por separado: percentiles 50, 99,
+//     99.9 y maximo (incluye los ~20 ns de leer el reloj). Antes se dan
+//     k_warmup pasos sin medir: TLSF recorre todo el heap y sin ellos los
+//     fallos de pagina de la primera vez que se toca dominan el p99.9.
+//   - fragmentacion: se intenta reservar la secuencia de texturas de
+//     bench/exact.cpp saltando las que no caben (texturas que caben, bytes
+//     pedidos y fragmentacion interna, 1 - pedido / asignado)
+
+namespace {
+
+constexpr size_t k_live = 512;
+constexpr size_t k_rounds = 500000;
+constexpr size_t k_warmup = 8 * k_rounds;
+
+size_t frame_size(Xorshift &rng) {
+  const uint64_t r = rng.next();
+  if (r % 8)
+    return (size_t(64) << (r >> 8) % 8) - (r >> 16) % 32;
+  return (size_t(16 * 1024) << (r >> 8) % 7) - (r >> 16) % 4096;
+}
+
+uint64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void percentiles(const char *label, std::vector<uint64_t> &samples) {
+  std::sort(samples.begin(), samples.end());
+  const auto at = [&](double p) {
+    return samples[static_cast<size_t>(p * (samples.size() - 1))];
+  };
+  std::cout << "  " << label << " p50 " << at(0.5) << " ns, p99 " << at(0.99)
+            << " ns, p99.9 " << at(0.999) << " ns, max " << samples.back()
+            << " ns\n";
+}
+
+template <class Heap> void latency(Heap &heap) {
+  Xorshift rng;
+  std::vector<void *> slots(k_live);
+  for (void *&slot : slots)
+    slot = heap.malloc(frame_size(rng));
+  for (size_t i = 0; i < k_warmup; ++i) {
+    void *&slot = slots[rng.next() % k_live];
+    heap.free(slot);
+    slot = heap.malloc(frame_size(rng));
+  }
+
+  std::vector<uint64_t> mallocs, frees;
+  mallocs.reserve(k_rounds);
+  frees.reserve(k_rounds);
+  size_t failed = 0;
+  for (size_t i = 0; i < k_rounds; ++i) {
+    void *&slot = slots[rng.next() % k_live];
+    const size_t size = frame_size(rng);
+    uint64_t start = now_ns();
+    heap.free(slot);
+    uint64_t end = now_ns();
+    frees.push_back(end - start);
+    start = now_ns();
+    slot = heap.malloc(size);
+    end = now_ns();
+    mallocs.push_back(end - start);
+    failed += !slot;
+  }
+  percentiles("malloc:", mallocs);
+  percentiles("free:  ", frees);
+  if (failed)
+    std::cout << "  " << failed << " reservas fallidas\n";
+  for (void *slot : slots)
+    heap.free(slot);
+}
+
+template <class Heap>
+void fragmentation(Heap &heap, const std::vector<size_t> &sizes) {
+  std::vector<void *> live(sizes.size());
+  size_t count = 0, requested = 0, allocated = 0;
+  for (size_t i = 0; i < sizes.size(); ++i) {
+    live[i] = heap.malloc(sizes[i]);
+    if (!live[i])
+      continue;
+    ++count;
+    requested += sizes[i];
+    allocated += heap.usable_size(live[i]);
+  }
+  std::cout << "  " << count << " texturas, " << requested / (1024 * 1024)
+            << " MB pedidos, " << std::fixed << std::setprecision(1)
+            << 100.0 * (allocated - requested) / allocated
+            << "% fragmentacion interna\n";
+  for (size_t i = 0; i < live.size(); ++i)
+    heap.free(live[i]);
+}
+
+template <class Heap>
+void run(const char *label, const std::vector<size_t> &sizes) {
+  static Heap heap;
+  std::cout << label << "\n";
+  latency(heap);
+  fragmentation(heap, sizes);
+}
+
+} // namespace
+
+int main() {
+  const std::vector<size_t> sizes = texture_sizes();
+  run<Default_buddy>("Buddy binario", sizes);
+  run<Default_tlsf>("TLSF", sizes);
+  return 0;
+}
@@ -0,0 +1,73 @@
+#include "../head/buddy.h"
+#include "../head/wbuddy.h"
+#include "bench.h"
+#include <vector>
+
+// Buddy ponderado (bloques de 2^k y 3 * 2^k) frente al buddy binario con los
+// tamanos de textura de bench/exact.cpp: lado 64 .. 1024 px, 3 o 4 canales.
+// Para cada motor:
+//   - se intenta reservar toda la secuencia, saltando las que no caben:
+//     texturas que caben, bytes pedidos y fragmentacion interna
+//     (1 - pedido / asignado)
+//   - rotacion: 16 texturas vivas y en cada paso se libera una al azar y se
+//     reserva la siguiente de la secuencia
+
+namespace {
+
+constexpr size_t k_live = 16;
+constexpr size_t k_rounds = 200000;
+
+template <class Heap>
+void run(const char *label, const std::vector<size_t> &sizes) {
+  static Heap heap;
+  std::vector<void *> live(sizes.size());
+  size_t count = 0, requested = 0, allocated = 0;
+  for (size_t i = 0; i < sizes.size(); ++i) {
+    live[i] = heap.malloc(sizes[i]);
+    if (!live[i])
+      continue;
+    ++count;
+    requested += sizes[i];
+    allocated += heap.usable_size(live[i]);
+  }
+  std::cout << label << ": " << count << " texturas, "
+            << requested / (1024 * 1024) << " MB pedidos, " << std::fixed
+            << std::setprecision(1)
+            << 100.0 * (allocated - requested) / allocated
+            << "% fragmentacion interna\n";
+  for (size_t i = 0; i < live.size(); ++i)
+    if (live[i])
+      heap.free(live[i], sizes[i]);
+
+  Xorshift rng;
+  std::vector<void *> slots(k_live);
+  std::vector<size_t> slot_sizes(k_live);
+  for (size_t i = 0; i < k_live; ++i) {
+    slot_sizes[i] = sizes[i];
+    slots[i] = heap.malloc(sizes[i]);
+  }
+  size_t failed = 0;
+  const double ns = time_ns([&] {
+    for (size_t i = 0; i < k_rounds; ++i) {
+      const size_t slot = rng.next() % k_live;
+      heap.free(slots[slot], slot_sizes[slot]);
+      slot_sizes[slot] = sizes[(k_live + i) % sizes.size()];
+      slots[slot] = heap.malloc(slot_sizes[slot]);
+      failed += !slots[slot];
+    }
+  });
+  report("  rotacion malloc/free", ns, 2 * k_rounds);
+  if (failed)
+    std::cout << "  " << failed << " reservas fallidas\n";
+  for (size_t i = 0; i < k_live; ++i)
+    heap.free(slots[i], slot_sizes[i]);
+}
+
+} // namespace
+
+int main() {
+  const std::vector<size_t> sizes = texture_sizes();
+  run<Default_buddy>("Buddy binario  ", sizes);
+  run<Default_weighted_buddy>("Buddy ponderado", sizes);
+  return 0;
+}
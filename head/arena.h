@@ -0,0 +1,244 @@
+#pragma once
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "buddy.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Frente multi-arena: crea heaps buddy (arenas) bajo demanda cuando los
+// existentes se llenan y destruye los que quedan vacios.
+// Cada arena esta alineada a su tamano (Arena::k_size), asi que el dueno de
+// un puntero se encuentra en O(1) con ptr >> log2(k_size).
+// Histeresis: se conservan hasta spare_arenas arenas vacias para no crear y
+// destruir una arena en cada oscilacion alrededor del limite.
+template <class Arena = Default_buddy> class Buddy_arenas {
+public:
+  explicit Buddy_arenas(const Buddy_options &options = Buddy_options(),
+                        size_t max_arenas = 16, size_t spare_arenas = 1);
+  Buddy_arenas(const Buddy_arenas &) = delete;
+  Buddy_arenas &operator=(const Buddy_arenas &) = delete;
+
+  void *malloc(const size_t);
+  void free(void *);
+  void free(void *, size_t size);
+  void *malloc_exact(const size_t);
+  void free_exact(void *, size_t size);
+  // Bytes que ocupa ptr de malloc_exact(size) en su arena
+  size_t exact_size(void *ptr, size_t size) const;
+
+  size_t arena_count() const { return arenas.size(); }
+  // Consultas O(1) por arena; cuentan con las arenas que aun pueden crearse
+  size_t largest_free_block() const;
+  bool can_allocate(size_t size) const;
+  size_t reserved_bytes() const;
+  size_t resident_bytes() const;
+  size_t released_bytes() const;
+  size_t metadata_bytes() const;
+  size_t managed_bytes() const { return arenas.size() * Arena::k_size; }
+
+private:
+  static constexpr size_t k_arena_shift = log2(Arena::k_size);
+
+  Buddy_options options;
+  size_t max_arenas;
+  size_t spare_arenas;
+  std::vector<std::unique_ptr<Arena>> arenas;
+  std::unordered_map<uintptr_t, Arena *> owners;
+  // Arena que atendio la ultima peticion: se prueba primero
+  Arena *current = nullptr;
+  size_t empty_arenas = 0;
+  // Bytes devueltos por arenas ya destruidas
+  size_t retired_released = 0;
+
+  static uintptr_t key(const void *ptr) {
+    return reinterpret_cast<uintptr_t>(ptr) >> k_arena_shift;
+  }
+  template <class Allocate> void *allocate(size_t size, Allocate &&allocate);
+  Arena *owner(const void *ptr);
+  Arena *add_arena();
+  void retire_if_empty(Arena *);
+  void drop_arena(Arena *);
+};
+
+template <class Arena>
+Buddy_arenas<Arena>::Buddy_arenas(const Buddy_options &options,
+                                  size_t max_arenas, size_t spare_arenas)
+    : options(options), max_arenas(std::max<size_t>(max_arenas, 1)),
+      spare_arenas(spare_arenas) {
+  current = add_arena();
+  empty_arenas = 1;
+}
+
+template <class Arena> void *Buddy_arenas<Arena>::malloc(const size_t size) {
+  return allocate(size, [size](Arena *arena) { return arena->malloc(size); });
+}
+
+template <class Arena>
+void *Buddy_arenas<Arena>::malloc_exact(const size_t size) {
+  return allocate(size,
+                  [size](Arena *arena) { return arena->malloc_exact(size); });
+}
+
+// Recorrido comun de malloc y malloc_exact: arena actual, resto de arenas y,
+// si todas fallan, una arena nueva
+template <class Arena>
+template <class Allocate>
+void *Buddy_arenas<Arena>::allocate(size_t size, Allocate &&allocate) {
+  if (size == 0 || size > Arena::k_size)
+    return nullptr;
+
+  Arena *arena = current;
+  bool was_empty = arena->empty();
+  void *ptr = allocate(arena);
+
+  // Fallo en la arena actual: probar las demas antes de crecer
+  for (size_t i = 0; !ptr && i < arenas.size(); ++i) {
+    arena = arenas[i].get();
+    if (arena == current)
+      continue;
+    was_empty = arena->empty();
+    ptr = allocate(arena);
+  }
+  if (!ptr) {
+    if (arenas.size() >= max_arenas)
+      return nullptr;
+    // una arena nueva nunca se conto como vacia de reserva
+    arena = add_arena();
+    was_empty = false;
+    ptr = allocate(arena);
+    if (!ptr) {
+      drop_arena(arena);
+      return nullptr;
+    }
+  }
+
+  if (was_empty)
+    empty_arenas--;
+  current = arena;
+  return ptr;
+}
+
+template <class Arena> void Buddy_arenas<Arena>::free(void *ptr) {
+  if (Arena *arena = owner(ptr)) {
+    arena->free(ptr);
+    retire_if_empty(arena);
+  }
+}
+
+template <class Arena>
+void Buddy_arenas<Arena>::free(void *ptr, size_t size) {
+  if (Arena *arena = owner(ptr)) {
+    arena->free(ptr, size);
+    retire_if_empty(arena);
+  }
+}
+
+template <class Arena>
+void Buddy_arenas<Arena>::free_exact(void *ptr, size_t size) {
+  if (Arena *arena = owner(ptr)) {
+    arena->free_exact(ptr, size);
+    retire_if_empty(arena);
+  }
+}
+
+template <class Arena>
+size_t Buddy_arenas<Arena>::exact_size(void *ptr, size_t size) const {
+  auto it = owners.find(key(ptr));
+  return it == owners.end() ? 0 : it->second->exact_size(ptr, size);
+}
+
+template <class Arena> Arena *Buddy_arenas<Arena>::owner(const void *ptr) {
+  if (!ptr)
+    return nullptr;
+  auto it = owners.find(key(ptr));
+  return it == owners.end() ? nullptr : it->second;
+}
+
+template <class Arena>
+void Buddy_arenas<Arena>::retire_if_empty(Arena *arena) {
+  if (!arena->empty())
+    return;
+
+  // La arena queda vacia: se destruye solo si ya hay suficientes de reserva
+  if (empty_arenas >= spare_arenas && arenas.size() > 1) {
+    drop_arena(arena);
+  } else {
+    empty_arenas++;
+  }
+}
+
+template <class Arena> Arena *Buddy_arenas<Arena>::add_arena() {
+  arenas.push_back(std::make_unique<Arena>(options));
+  Arena *arena = arenas.back().get();
+  owners[key(arena->heap_base)] = arena;
+  return arena;
+}
+
+template <class Arena> void Buddy_arenas<Arena>::drop_arena(Arena *arena) {
+  owners.erase(key(arena->heap_base));
+  retired_released += arena->released_bytes();
+  for (auto it = arenas.begin(); it != arenas.end(); ++it) {
+    if (it->get() == arena) {
+      arenas.erase(it);
+      break;
+    }
+  }
+  if (current == arena)
+    current = arenas.front().get();
+}
+
+template <class Arena>
+size_t Buddy_arenas<Arena>::largest_free_block() const {
+  if (arenas.size() < max_arenas)
+    return Arena::k_size;
+  size_t largest = 0;
+  for (const auto &arena : arenas)
+    largest = std::max(largest, arena->largest_free_block());
+  return largest;
+}
+
+template <class Arena>
+bool Buddy_arenas<Arena>::can_allocate(size_t size) const {
+  if (size == 0 || size > Arena::k_size)
+    return false;
+  if (arenas.size() < max_arenas)
+    return true;
+  for (const auto &arena : arenas)
+    if (arena->can_allocate(size))
+      return true;
+  return false;
+}
+
+template <class Arena> size_t Buddy_arenas<Arena>::reserved_bytes() const {
+  size_t total = 0;
+  for (const auto &arena : arenas)
+    total += arena->reserved_bytes();
+  return total;
+}
+
+template <class Arena> size_t Buddy_arenas<Arena>::resident_bytes() const {
+  size_t total = 0;
+  for (const auto &arena : arenas)
+    total += arena->resident_bytes();
+  return total;
+}
+
+template <class Arena> size_t Buddy_arenas<Arena>::metadata_bytes() const {
+  size_t total = 0;
+  for (const auto &arena : arenas)
+    total += arena->metadata_bytes();
+  return total;
+}
+
+template <class Arena> size_t Buddy_arenas<Arena>::released_bytes() const {
+  size_t total = retired_released;
+  for (const auto &arena : arenas)
+    total += arena->released_bytes();
+  return total;
+}
+
+#endif // ARENA_H
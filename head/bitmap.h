@@ -0,0 +1,37 @@
+#pragma once
+#ifndef BITMAP_H
+#define BITMAP_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Mapa de bits jerarquico: cada palabra de un nivel resume 64 palabras del
+// nivel inferior (bit encendido <=> esa palabra no es cero). Encender,
+// apagar y buscar el primer bit encendido cuestan O(log64 n).
+// No es dueno de su memoria: attach recibe words_for(bits) palabras a cero.
+class Level_bitmap {
+public:
+  static constexpr size_t npos = ~size_t(0);
+
+  static size_t words_for(size_t bits);
+  void attach(uint64_t *words, size_t bits);
+
+  void set(size_t i);
+  void clear(size_t i);
+  bool test(size_t i) const;
+  // Algun bit encendido (basta con la palabra del nivel superior)
+  bool any() const { return level_count && levels[level_count - 1][0]; }
+  // Bits encendidos (recorre el nivel inferior)
+  size_t count() const;
+  // Indice del bit encendido mas bajo (npos si no hay ninguno)
+  size_t find_first() const;
+
+private:
+  // 64^11 > 2^64: nunca hacen falta mas niveles
+  static constexpr size_t k_max_levels = 11;
+  uint64_t *levels[k_max_levels] = {};
+  size_t level_count = 0;
+  size_t bit_count = 0;
+};
+
+#endif // BITMAP_H
@@ -6,48 +6,1340 @@
 #ifndef BUDDY_H
 #define BUDDY_H
 
+#include "bitmap.h"
 #include "block.h"
 #include "list.h"
+#include "snapshot.h"
+#include "vmem.h"
 #include <algorithm>
+#include <cassert>
 #include <cstdint>
+#include <cstring>
 #include <iterator>
+#include <mutex>
+#include <type_traits>
+#include <vector>
 constexpr size_t Min_alloc = sizeof(ListNode);
+// Menor r tal que 2^r >= n, con una sola instruccion (clz)
 constexpr size_t log2(const size_t n) {
-  size_t r = 0;
-  size_t m = 1;
-  while (n > m) {
-    r++;
-    if (m > std::numeric_limits<size_t>::max() / 2)
-      return r;
-    m *= 2;
-  }
-  return r;
+  static_assert(sizeof(size_t) == sizeof(unsigned long long));
+  return n <= 1 ? 0 : std::numeric_limits<size_t>::digits -
+                          __builtin_clzll(static_cast<size_t>(n - 1));
 }
+
+// Que bloque libre de un orden entrega malloc
+enum class Buddy_placement {
+  // El ultimo liberado (cabeza de la lista): O(1), pero los bloques quedan
+  // repartidos por todo el heap
+  lifo,
+  // El de menor direccion: los bloques de vida larga se agrupan al principio
+  // y la parte alta queda libre para coalescer. Cuesta un mapa de bits
+  // jerarquico por orden (un bit por nodo) y O(log64 n) por operacion.
+  lowest_address,
+};
+
+// Opciones de construccion del heap buddy
+struct Buddy_options {
+  // Respaldar el heap con paginas de 2 MB (MAP_HUGETLB o, si no hay, THP).
+  // La base queda alineada a 2 MB, asi que cada bloque de orden alto ocupa
+  // paginas grandes completas.
+  bool huge_pages = false;
+  // Los bloques que al liberarse coalescen hasta al menos release_size bytes
+  // devuelven sus paginas al sistema (0 = nunca). Vuelven a comprometerse
+  // solas, a cero, cuando el bloque se reutiliza (tambien en un heap
+  // restaurado: alli se sustituyen por memoria anonima, ver restore).
+  size_t release_size = 0;
+  // Devolverlas con MADV_FREE (perezoso) en lugar de MADV_DONTNEED
+  bool release_lazy = false;
+  Buddy_placement placement = Buddy_placement::lifo;
+  // Coalescencia perezosa (lazy buddy, Barkley y Lee): hasta lazy_slack
+  // bloques liberados por orden se guardan sin coalescer y el siguiente
+  // malloc de ese orden los reutiliza sin partir nada. Pasado el umbral, o
+  // cuando malloc no encuentra bloque, se coalesce como siempre (0 = nunca
+  // se difiere).
+  size_t lazy_slack = 0;
+  // Estado libre solo fuera del heap: sin listas enlazadas dentro de los
+  // bloques libres, cada orden es un mapa de bits jerarquico y malloc busca
+  // con ctz palabra a palabra. La memoria libre nunca se lee ni se escribe,
+  // asi que un heap reservado sin comprometer sigue sin comprometer hasta
+  // que se usa. Implica Buddy_placement::lowest_address.
+  bool bitmap_only = false;
+};
+
+// Resultado acumulado de Buddy_allocation::realloc
+struct Realloc_stats {
+  // Crecio absorbiendo hermanos libres sin mover los datos
+  size_t grown_in_place = 0;
+  // Encogio devolviendo sus mitades derechas a las listas libres
+  size_t shrunk_in_place = 0;
+  // Tuvo que reservar otro bloque y copiar
+  size_t moved = 0;
+};
+
+// Contadores de Buddy_allocation::coalesce_stats
+struct Coalesce_stats {
+  // Bloques partidos en dos por malloc
+  size_t splits = 0;
+  // Parejas de hermanos unidas por free
+  size_t merges = 0;
+  // free que dejaron el bloque sin coalescer (modo perezoso)
+  size_t deferred = 0;
+  // malloc servidos con un bloque diferido
+  size_t reused = 0;
+};
+
+// Cerrojo vacio para el modo monohilo
+struct Null_mutex {
+  void lock() {}
+  void unlock() {}
+};
+
+// Heap buddy de HeapSize bytes con bloques minimos de MinBlock bytes.
+// Ambos deben ser potencias de 2; toda la aritmetica de indices se resuelve
+// en tiempo de compilacion para cada configuracion.
+// El heap y sus metadatos se reservan con mmap sin comprometer memoria: solo
+// ocupan RAM las paginas que llegan a tocarse, por lo que HeapSize puede ser
+// de decenas de GB. La base del heap esta alineada a HeapSize, de modo que
+// el heap que contiene un puntero se obtiene con una mascara.
+// Con Concurrent = true malloc/free pueden llamarse desde varios hilos: cada
+// orden tiene su cerrojo y split/coalesce solo toman los ordenes que tocan,
+// siempre de menor a mayor (jerarquia que evita interbloqueos).
+template <size_t HeapSize, size_t MinBlock = Min_alloc,
+          bool Concurrent = false>
 class Buddy_allocation {
 public:
-  static constexpr size_t k_size = 64 * 1024 * 1024;
+  static constexpr size_t k_size = HeapSize;
+  static constexpr size_t k_min_block = MinBlock;
+  static constexpr bool k_concurrent = Concurrent;
   void *malloc(const size_t);
   void free(void *);
-  Buddy_allocation();
+  // free sin leer los metadatos: el orden sale de size, que debe ser el
+  // tamano pedido a malloc (como operator delete(void *, size_t)). Con
+  // BUDDY_DEBUG (make DEBUG=1) se comprueba contra el orden guardado.
+  void free(void *, size_t size);
+  // Reserva count bloques de size bytes en out[] partiendo cada bloque grande
+  // de una sola pasada. Devuelve cuantos consiguio (menos si se agota el heap)
+  size_t malloc_bulk(size_t count, size_t size, void **out);
+  // Libera n punteros: ordena ptrs por direccion (queda reordenado) y une los
+  // hermanos entre si antes de tocar las listas libres
+  void free_bulk(void **ptrs, size_t n);
+  // Cambia el tamano del bloque sin moverlo cuando puede: crece si ptr es el
+  // hijo izquierdo y sus hermanos derechos estan libres, encoge liberando las
+  // mitades derechas. Solo en otro caso reserva, copia y libera.
+  // No admite bloques de malloc_exact (ver alli).
+  void *realloc(void *ptr, size_t size);
+  // Bloque de al menos size bytes alineado a alignment (potencia de 2 de
+  // hasta k_size; 0 equivale a MinBlock, sin alineacion extra). Devuelve
+  // nullptr si alignment no es potencia de 2 o es mayor que k_size.
+  // Cada bloque esta alineado a su tamano respecto a la base,
+  // y la base a k_size, asi que basta con subir el orden hasta alignment.
+  // Sobre una region ajena falla si su base no esta alineada a alignment.
+  // El bloque es de max(size, alignment): free(ptr, size) debe recibir ese
+  // tamano redondeado, no size.
+  void *aligned_malloc(size_t size, size_t alignment);
+  // Reserva exacta (como alloc_pages_exact): del bloque potencia de 2 solo se
+  // queda con size redondeado a MinBlock y devuelve la cola a las listas. Lo
+  // conservado es una serie de bloques buddy, uno por bit de ese numero de
+  // granulos, que free_exact reconstruye a partir del mismo size.
+  // Los metadatos solo describen el primer trozo y la cola ya esta en las
+  // listas, asi que el bloque debe liberarse con free_exact y el mismo size:
+  // free, realloc o usable_size solo verian el primer trozo.
+  void *malloc_exact(size_t size);
+  void free_exact(void *ptr, size_t size);
+  // Bytes que ocupa el bloque ptr de malloc_exact(size)
+  size_t exact_size(void *, size_t size) const {
+    return (size + MinBlock - 1) & ~(MinBlock - 1);
+  }
+  Realloc_stats realloc_stats() const;
+  Coalesce_stats coalesce_stats() const;
+  // Coalesce todos los bloques diferidos (solo con Buddy_options::lazy_slack)
+  void flush();
+  // Instantanea del heap completo (contenido, split_nodes, ordenes y listas
+  // libres o, con bitmap_only, sus mapas de bits) en path. Los enlaces de las
+  // listas se guardan como desplazamientos desde la base, asi que restore
+  // puede cargarla en un heap con otra direccion. Los tramos a cero quedan
+  // como huecos. Se escribe en un temporal que se renombra sobre path al
+  // terminar, asi que se puede guardar sobre el fichero que proyecta un heap
+  // restaurado.
+  // Ninguna de las dos admite llamadas concurrentes con malloc/free.
+  bool save(const char *path);
+  // Sustituye el estado actual por la instantanea de path: los metadatos se
+  // copian y el contenido se proyecta con mmap (copia en escritura) en una
+  // reserva nueva, asi que heap_base cambia. Se lee del fichero al tocarlo,
+  // por eso mientras viva el heap el fichero no debe truncarse ni
+  // modificarse en su sitio; borrarlo o sustituirlo (con save o rename) no
+  // le afecta. Falla sin cambiar nada si el fichero no es de un heap con la
+  // misma configuracion o si no se puede leer o proyectar.
+  // Con release_size, las paginas que se devuelven despues dejan de
+  // proyectar el fichero (mmap anonimo encima): MADV_DONTNEED las volveria
+  // a leer de la instantanea en lugar de darlas a cero.
+  bool restore(const char *path);
+  bool owns(const void *ptr) const {
+    return ptr >= heap_base && ptr < heap_base + region_size;
+  }
+  // Tamano real del bloque al que apunta ptr (potencia de 2 >= lo pedido)
+  size_t usable_size(void *ptr) { return block_size(get_order(ptr)); }
+  explicit Buddy_allocation(const Buddy_options &options = Buddy_options());
+  // Heap sobre memoria del llamador (un fichero proyectado, un segmento
+  // compartido, una zona de staging), que no se libera al destruirlo.
+  // length no tiene por que ser potencia de 2: la region se cubre con una
+  // raiz por bit de su numero de granulos, de mayor a menor orden, y solo se
+  // pierde lo que no llega a MinBlock. Gestiona como mucho k_size bytes;
+  // los bloques quedan alineados respecto a base (subida a MinBlock).
+  // huge_pages y release_size no tienen efecto (la memoria es del llamador:
+  // puede estar fijada, compartida o respaldada por un fichero y no se le
+  // hace madvise) y save/restore no estan disponibles.
+  Buddy_allocation(void *base, size_t length,
+                   const Buddy_options &options = Buddy_options());
   ~Buddy_allocation();
+  Buddy_allocation(const Buddy_allocation &) = delete;
+  Buddy_allocation &operator=(const Buddy_allocation &) = delete;
   alignas(std::max_align_t) char *heap_base = nullptr;
 
+  // Todo el heap esta libre (la raiz esta en su lista o, si hay varias
+  // raices o bloques diferidos, todo lo gestionado esta en las listas)
+  bool empty() const {
+    return ((load(free_orders) >> k_maximum_order) & 1) ||
+           (count_listed &&
+            load(listed_bytes) + load(deferred_bytes) == region_size);
+  }
+  // Mayor bloque libre (0 si no queda ninguno) y si malloc(size) tendria
+  // exito, en O(1) con free_orders. En modo concurrente son orientativos; en
+  // modo perezoso un malloc fallido coalesce los diferidos, asi que
+  // can_allocate puede dar falsos negativos hasta flush().
+  size_t largest_free_block() const;
+  bool can_allocate(size_t size) const;
+
+  // Bytes de espacio virtual reservados (heap + metadatos)
+  size_t reserved_bytes() const;
+  // Bytes de metadatos fuera del heap y bytes que gestionan: con bloques
+  // minimos de 16 B, 1 / 128 en bits XOR y 9 / 1024 en ordenes (antes 1 / 16)
+  size_t metadata_bytes() const {
+    return k_split_bytes + k_order_words * (sizeof(uint64_t) + 1) +
+           free_map_bytes;
+  }
+  size_t managed_bytes() const { return region_size; }
+  // Bytes de esa reserva que realmente ocupan memoria fisica
+  size_t resident_bytes() const;
+  // Tipo de paginas que respaldan el heap
+  vmem::Backing backing() const { return heap_backing; }
+  // Bytes devueltos al sistema por bloques coalescidos (acumulado)
+  size_t released_bytes() const { return load(released); }
+
+  static constexpr size_t k_maximum_order = log2(k_size) - log2(MinBlock);
+  static constexpr size_t k_order_count = k_maximum_order + 1;
+
 private:
-  static constexpr size_t k_maximum_order = log2(k_size) - log2(Min_alloc);
-  ListNode free_lists[k_maximum_order + 1] = {};
-  uint8_t split_nodes[(1 << k_maximum_order) / 8] = {};
-  uint8_t *metadata_orders = nullptr;
+  static_assert((HeapSize & (HeapSize - 1)) == 0,
+                "HeapSize no es potencia de 2");
+  static_assert((MinBlock & (MinBlock - 1)) == 0,
+                "MinBlock no es potencia de 2");
+  static_assert(MinBlock >= sizeof(ListNode),
+                "MinBlock debe poder alojar un ListNode");
+  static_assert(HeapSize >= MinBlock, "HeapSize menor que MinBlock");
+
+  ListNode free_lists[k_order_count] = {};
+  // bit k encendido <=> free_lists[k] no esta vacia
+  uint64_t free_orders = 0;
+  // El cerrojo del orden k protege free_lists[k] y los bits de split_nodes
+  // de los nodos cuyos hijos son de orden k
+  using Order_mutex = std::conditional_t<Concurrent, std::mutex, Null_mutex>;
+  Order_mutex order_locks[k_order_count];
+  static_assert(k_maximum_order < 64,
+                "free_orders no cubre todos los ordenes");
+  static constexpr size_t k_split_bytes =
+      std::max<size_t>((size_t(1) << k_maximum_order) / 8, 1);
+  uint8_t *split_nodes = nullptr;
+  // Orden de los bloques asignados sin un byte por granulo de MinBlock:
+  //  - order_ends: un bit por granulo, encendido en el ultimo granulo de cada
+  //    bloque asignado de menos de 64 granulos. Esos bloques, alineados a su
+  //    tamano, nunca cruzan una palabra: su orden sale de un ctz.
+  //  - large_orders: un byte por palabra con el orden del bloque mayor que
+  //    empieza en ella (0 si la palabra es de bloques pequenos).
+  static constexpr size_t k_word_orders = 6;
+  static constexpr size_t k_order_words =
+      std::max<size_t>((k_size / MinBlock) >> k_word_orders, 1);
+  uint64_t *order_ends = nullptr;
+  uint8_t *large_orders = nullptr;
+  // Solo con Buddy_placement::lowest_address: bloques libres de cada orden
+  // por posicion, protegidos por el cerrojo de su orden. Con bitmap_only son
+  // el unico registro de bloques libres y free_lists queda vacia.
+  bool address_ordered = false;
+  bool bitmap_only = false;
+  Level_bitmap free_maps[k_order_count];
+  uint64_t *free_map_words = nullptr;
+  size_t free_map_bytes = 0;
+  vmem::Backing heap_backing = vmem::Backing::normal;
+  // 0 si el heap es memoria del llamador
+  size_t heap_reserved = k_size;
+  // Bytes gestionados desde heap_base (k_size salvo en una region ajena)
+  size_t region_size = k_size;
+  // Devolucion de paginas: orden umbral (k_order_count = desactivado)
+  size_t release_order = k_order_count;
+  size_t release_granularity = 0;
+  // Bytes del principio de un bloque liberado que no se devuelven: la
+  // pagina con su ListNode (ninguno con bitmap_only)
+  size_t release_kept = 0;
+  bool release_lazy = false;
+  // El heap proyecta una instantanea (restore): se devuelve con
+  // discard_anonymous
+  bool heap_from_file = false;
+  size_t released = 0;
+  size_t grown_in_place = 0;
+  size_t shrunk_in_place = 0;
+  size_t moved = 0;
+  // Modo perezoso: bloques diferidos de cada orden en una lista simple (el
+  // primer puntero del bloque es el enlace), protegida por el cerrojo de su
+  // orden. Siguen marcados como asignados en split_nodes y conservan su
+  // orden en order_ends/large_orders.
+  size_t lazy_slack = 0;
+  void *deferred_lists[k_order_count] = {};
+  size_t deferred_counts[k_order_count] = {};
+  uint64_t deferred_orders = 0;
+  size_t deferred_bytes = 0;
+  // Bytes en free_lists, solo contados con count_listed (modo perezoso o
+  // varias raices), cuando la raiz libre no basta para saber si esta vacio
+  bool count_listed = false;
+  size_t listed_bytes = 0;
+  // Contadores de cada orden, modificados bajo su cerrojo
+  Coalesce_stats order_stats[k_order_count];
+
+  // Aritmetica del arbol implicito (raiz = 0, orden maximo en la raiz)
+  static constexpr size_t block_size(size_t order) {
+    return MinBlock << order;
+  }
+  static constexpr size_t first_index(size_t order) {
+    return (size_t(1) << (k_maximum_order - order)) - 1;
+  }
+  static constexpr size_t offset_to_index(size_t offset, size_t order) {
+    return first_index(order) + offset / block_size(order);
+  }
+  static constexpr size_t index_to_offset(size_t index, size_t order) {
+    return (index - first_index(order)) * block_size(order);
+  }
+  static constexpr size_t parent(size_t i) { return (i - 1) / 2; }
+  static constexpr size_t child_left(size_t i) { return 2 * i + 1; }
+  static constexpr size_t child_right(size_t i) { return 2 * i + 2; }
+  static constexpr size_t sibling(size_t i) { return ((i - 1) ^ 1) + 1; }
+
+  // Palabras compartidas entre ordenes distintos (free_orders, bytes de
+  // split_nodes, contadores): atomicas solo en modo concurrente
+  template <typename T> static T load(const T &word) {
+    return __atomic_load_n(&word, __ATOMIC_RELAXED);
+  }
+  template <typename T> static void atomic_or(T &word, T bits) {
+    if constexpr (Concurrent)
+      __atomic_fetch_or(&word, bits, __ATOMIC_RELAXED);
+    else
+      word |= bits;
+  }
+  template <typename T> static void atomic_and(T &word, T bits) {
+    if constexpr (Concurrent)
+      __atomic_fetch_and(&word, bits, __ATOMIC_RELAXED);
+    else
+      word &= bits;
+  }
+  template <typename T> static void atomic_xor(T &word, T bits) {
+    if constexpr (Concurrent)
+      __atomic_fetch_xor(&word, bits, __ATOMIC_RELAXED);
+    else
+      word ^= bits;
+  }
+  template <typename T> static void atomic_add(T &word, T value) {
+    if constexpr (Concurrent)
+      __atomic_fetch_add(&word, value, __ATOMIC_RELAXED);
+    else
+      word += value;
+  }
+  void unlock_orders(size_t low, size_t high);
+
   size_t index_to_node(ListNode *, size_t);
   ListNode *node_to_index(size_t, size_t);
-  size_t parent(size_t) const;
-  size_t child_left(size_t) const;
-  size_t child_right(size_t) const;
-  size_t sibling(size_t) const;
+  size_t position(const ListNode *node, size_t order) const {
+    return (reinterpret_cast<const char *>(node) - heap_base) >>
+           (log2(MinBlock) + order);
+  }
   bool can_split(size_t) const;
   void to_split(size_t);
+  bool order_empty(size_t order) const {
+    return bitmap_only ? !free_maps[order].any() : free_lists[order].empty();
+  }
+
+  void push_free(size_t order, ListNode *);
+  ListNode *pop_free(size_t order);
+  void remove_free(size_t order, ListNode *);
 
-  void set_order(void *ptr, uint8_t order);
-  uint8_t get_order(void *ptr);
+  void init(const Buddy_options &);
+  void *take_block(size_t required_order);
+  void *reuse_deferred(size_t order);
+  bool defer(ListNode *, size_t order);
+  void release_pages(ListNode *, size_t order, size_t fresh);
+  bool grow_in_place(void *ptr, size_t order, size_t new_order);
+  // Solo para bloques buddy completos, nunca para los de malloc_exact
+  void shrink_in_place(void *ptr, size_t order, size_t new_order);
+  void free_block(ListNode *, size_t order);
+  size_t carve(ListNode *, size_t order, size_t required_order, size_t count,
+               void **out);
+  void release_tail(char *base, size_t order, size_t unit_order,
+                    size_t taken);
+
+  void set_order(void *ptr, size_t order);
+  size_t get_order(void *ptr) const;
+
+  // Cabecera de la instantanea. Un enlace guardado es el desplazamiento del
+  // nodo desde la base o, si apunta al centinela de free_lists[k], k_size + k.
+  struct Snapshot_header {
+    char magic[8];
+    uint64_t heap_size;
+    uint64_t min_block;
+    uint64_t split_offset;
+    uint64_t ends_offset;
+    uint64_t large_offset;
+    uint64_t heap_offset;
+    // Mapas de bits libres, solo en instantaneas de un heap bitmap_only (0
+    // en otro caso: se reconstruyen desde las listas)
+    uint64_t free_map_offset;
+    // Primer y ultimo nodo de cada lista libre
+    uint64_t heads[k_order_count][2];
+  };
+  static constexpr char k_snapshot_magic[8] = {'B', 'U', 'D', 'D',
+                                               'Y', 'S', 'N', '2'};
+  uint64_t encode_link(const ListNode *) const;
+  ListNode *decode_link(uint64_t);
 };
 
+// Configuracion historica (64 MB, bloques de 16 B) usada por VRAMManager
+using Default_buddy = Buddy_allocation<64 * 1024 * 1024>;
+// La misma configuracion, utilizable desde varios hilos
+using Concurrent_buddy = Buddy_allocation<64 * 1024 * 1024, Min_alloc, true>;
+
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+Buddy_allocation<HeapSize, MinBlock, Concurrent>::Buddy_allocation(
+    const Buddy_options &options) {
+
+  // Reservas perezosas: mmap entrega paginas a cero al tocarlas
+  heap_base = static_cast<char *>(vmem::reserve_heap(
+      k_size, options.huge_pages, heap_reserved, heap_backing));
+  init(options);
+}
+
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+Buddy_allocation<HeapSize, MinBlock, Concurrent>::Buddy_allocation(
+    void *base, size_t length, const Buddy_options &options) {
+  const uintptr_t addr = reinterpret_cast<uintptr_t>(base);
+  const uintptr_t aligned = (addr + MinBlock - 1) & ~uintptr_t(MinBlock - 1);
+  const size_t usable = length > aligned - addr ? length - (aligned - addr) : 0;
+  heap_base = reinterpret_cast<char *>(aligned);
+  heap_reserved = 0;
+  region_size = std::min(usable & ~(MinBlock - 1), k_size);
+  init(options);
+}
+
+// Metadatos, opciones y raices comunes a los dos constructores
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+void Buddy_allocation<HeapSize, MinBlock, Concurrent>::init(
+    const Buddy_options &options) {
+
+  // Sobre una region del llamador nunca se descartan paginas
+  if (options.release_size && heap_reserved) {
+    release_granularity = heap_backing == vmem::Backing::explicit_huge
+                              ? vmem::k_huge_page
+                              : vmem::page_size();
+    release_lazy = options.release_lazy;
+    release_kept = options.bitmap_only ? 0 : release_granularity;
+    // Ademas de la pagina con el ListNode debe quedar al menos otra entera
+    const size_t threshold = std::max(
+        {options.release_size, release_kept + release_granularity, MinBlock});
+    release_order = std::min(log2(threshold) - log2(MinBlock), k_order_count);
+  }
+  split_nodes = static_cast<uint8_t *>(vmem::reserve(k_split_bytes));
+  order_ends = static_cast<uint64_t *>(
+      vmem::reserve(k_order_words * sizeof(uint64_t)));
+  large_orders = static_cast<uint8_t *>(vmem::reserve(k_order_words));
+
+  lazy_slack = options.lazy_slack;
+  bitmap_only = options.bitmap_only;
+  count_listed = lazy_slack || region_size != k_size;
+  if (options.placement == Buddy_placement::lowest_address || bitmap_only) {
+    address_ordered = true;
+    size_t words = 0;
+    for (size_t order = 0; order < k_order_count; ++order)
+      words += Level_bitmap::words_for(size_t(1) << (k_maximum_order - order));
+    free_map_bytes = words * sizeof(uint64_t);
+    free_map_words = static_cast<uint64_t *>(vmem::reserve(free_map_bytes));
+    uint64_t *next = free_map_words;
+    for (size_t order = 0; order < k_order_count; ++order) {
+      const size_t bits = size_t(1) << (k_maximum_order - order);
+      free_maps[order].attach(next, bits);
+      next += Level_bitmap::words_for(bits);
+    }
+  }
+
+  // Una raiz por bit del numero de granulos (una sola con el heap propio).
+  // Cada raiz es hijo izquierdo de un nodo cuyo hijo derecho contiene el
+  // final de la region, que nunca esta libre entero: no coalescen entre si.
+  const size_t granules = region_size / MinBlock;
+  char *root = heap_base;
+  for (size_t order = k_order_count; order-- > 0;) {
+    if (!(granules >> order & 1))
+      continue;
+    auto node = reinterpret_cast<ListNode *>(root);
+    push_free(order, node);
+    if (order < k_maximum_order)
+      to_split(parent(index_to_node(node, order)));
+    root += block_size(order);
+  }
+}
+
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+Buddy_allocation<HeapSize, MinBlock, Concurrent>::~Buddy_allocation() {
+  if (heap_reserved)
+    vmem::release(heap_base, heap_reserved);
+  vmem::release(split_nodes, k_split_bytes);
+  vmem::release(order_ends, k_order_words * sizeof(uint64_t));
+  vmem::release(large_orders, k_order_words);
+  if (free_map_words)
+    vmem::release(free_map_words, free_map_bytes);
+}
+
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+size_t
+Buddy_allocation<HeapSize, MinBlock, Concurrent>::reserved_bytes() const {
+  return heap_reserved + metadata_bytes();
+}
+
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+size_t
+Buddy_allocation<HeapSize, MinBlock, Concurrent>::largest_free_block() const {
+  const uint64_t orders = load(free_orders) | load(deferred_orders);
+  return orders ? block_size(63 - __builtin_clzll(orders)) : 0;
+}
+
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+bool Buddy_allocation<HeapSize, MinBlock, Concurrent>::can_allocate(
+    size_t size) const {
+  if (size == 0 || size > k_size)
+    return false;
+  return (load(free_orders) | load(deferred_orders)) >>
+         (log2(std::max(size, MinBlock)) - log2(MinBlock));
+}
+
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+size_t
+Buddy_allocation<HeapSize, MinBlock, Concurrent>::resident_bytes() const {
+  return vmem::resident_bytes(heap_base,
+                              heap_reserved ? heap_reserved : region_size) +
+         vmem::resident_bytes(split_nodes, k_split_bytes) +
+         vmem::resident_bytes(order_ends, k_order_words * sizeof(uint64_t)) +
+         vmem::resident_bytes(large_orders, k_order_words);
+}
+
+// Al asignar se reescriben los bits de todo el rango del bloque, asi que las
+// marcas que dejo un bloque ya liberado nunca se confunden con las de uno
+// vivo y free no necesita tocar los metadatos.
+// Una palabra de order_ends puede compartirse entre bloques de varios hilos:
+// se modifica con operaciones atomicas. large_orders[w] solo lo toca el
+// dueno del bloque que empieza en w.
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+void Buddy_allocation<HeapSize, MinBlock, Concurrent>::set_order(
+    void *ptr, size_t order) {
+  const size_t granule = (static_cast<char *>(ptr) - heap_base) / MinBlock;
+  uint64_t &ends = order_ends[granule >> k_word_orders];
+  if (order >= k_word_orders) {
+    __atomic_store_n(&ends, 0, __ATOMIC_RELAXED);
+    large_orders[granule >> k_word_orders] = static_cast<uint8_t>(order);
+    return;
+  }
+  const size_t blocks = size_t(1) << order;
+  const uint64_t range = ((uint64_t(1) << blocks) - 1) << (granule & 63);
+  const uint64_t end = uint64_t(1) << ((granule & 63) + blocks - 1);
+  if ((load(ends) & range) != end) {
+    atomic_and(ends, ~range);
+    atomic_or(ends, end);
+  }
+}
+
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+size_t
+Buddy_allocation<HeapSize, MinBlock, Concurrent>::get_order(void *ptr) const {
+  const size_t granule = (static_cast<char *>(ptr) - heap_base) / MinBlock;
+  // El primer fin de bloque a partir del granulo marca el tamano. Si no hay
+  // ninguno el bloque cubre la palabra entera y es de los grandes.
+  const uint64_t ends =
+      load(order_ends[granule >> k_word_orders]) >> (granule & 63);
+  if (ends)
+    return log2(__builtin_ctzll(ends) + 1);
+  return large_orders[granule >> k_word_orders];
+}
+
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+void Buddy_allocation<HeapSize, MinBlock, Concurrent>::push_free(
+    size_t order, ListNode *node) {
+  if (!bitmap_only) {
+    // el bloque puede contener datos de un uso anterior
+    node->prev = nullptr;
+    node->next = nullptr;
+    free_lists[order].push(node);
+  }
+  if (address_ordered)
+    free_maps[order].set(position(node, order));
+  if (count_listed)
+    atomic_add(listed_bytes, block_size(order));
+  atomic_or(free_orders, uint64_t(1) << order);
+}
+
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+ListNode *
+Buddy_allocation<HeapSize, MinBlock, Concurrent>::pop_free(size_t order) {
+  ListNode *node;
+  if (address_ordered) {
+    const size_t first = free_maps[order].find_first();
+    node = reinterpret_cast<ListNode *>(heap_base + first * block_size(order));
+    if (!bitmap_only)
+      node->remove();
+    free_maps[order].clear(first);
+  } else {
+    node = free_lists[order].pop();
+  }
+  if (count_listed)
+    atomic_add(listed_bytes, -block_size(order));
+  if (order_empty(order))
+    atomic_and(free_orders, ~(uint64_t(1) << order));
+  return node;
+}
+
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+void Buddy_allocation<HeapSize, MinBlock, Concurrent>::remove_free(
+    size_t order, ListNode *node) {
+  if (!bitmap_only)
+    node->remove();
+  if (address_ordered)
+    free_maps[order].clear(position(node, order));
+  if (count_listed)
+    atomic_add(listed_bytes, -block_size(order));
+  if (order_empty(order))
+    atomic_and(free_orders, ~(uint64_t(1) << order));
+}
+
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+void Buddy_allocation<HeapSize, MinBlock, Concurrent>::unlock_orders(
+    size_t low, size_t high) {
+  for (size_t order = low; order <= high; ++order)
+    order_locks[order].unlock();
+}
+
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+void *
+Buddy_allocation<HeapSize, MinBlock, Concurrent>::malloc(const size_t request) {
+
+  if (request == 0 || request > k_size)
+    return nullptr;
+
+  const size_t r_size = std::max(request, MinBlock);
+
+  const size_t required_order = log2(r_size) - log2(MinBlock);
+  // Si aun con el mayor orden no hay sitio, falla
+  if (required_order > k_maximum_order)
+    return nullptr;
+
+  if (!lazy_slack)
+    return take_block(required_order);
+  // Modo perezoso: primero un bloque diferido del mismo orden; si no hay
+  // ninguno y tampoco bloque libre, se coalesce todo y se reintenta
+  if (void *ptr = reuse_deferred(required_order))
+    return ptr;
+  void *ptr = take_block(required_order);
+  if (!ptr && load(deferred_bytes)) {
+    flush();
+    ptr = take_block(required_order);
+  }
+  return ptr;
+}
+
+// Saca de las listas un bloque de required_order, partiendo uno mayor si
+// hace falta
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+void *Buddy_allocation<HeapSize, MinBlock, Concurrent>::take_block(
+    const size_t required_order) {
+  // Sin hilos la mascara es exacta: un fallo se resuelve sin tocar las listas
+  if (!Concurrent && !(free_orders >> required_order))
+    return nullptr;
+
+  // Buscar bloque de memoria libre: el menor orden no vacio >= required_order.
+  // Se mantienen tomados los cerrojos de required_order..order, los unicos
+  // ordenes que el split modifica; free_orders es solo una pista que se
+  // revalida bajo el cerrojo de cada orden.
+  size_t order = required_order;
+  order_locks[order].lock();
+  while (order_empty(order)) {
+    const uint64_t candidates =
+        order < k_maximum_order
+            ? load(free_orders) & (~uint64_t(0) << (order + 1))
+            : 0;
+    // Un free a medio coalescer puede dejar la mascara sin su bloque: en
+    // modo concurrente, sin pista, se sube orden a orden esperando su cerrojo
+    size_t next = k_order_count;
+    if (candidates)
+      next = __builtin_ctzll(candidates);
+    else if (Concurrent)
+      next = order + 1;
+    if (next > k_maximum_order) {
+      unlock_orders(required_order, order);
+      return nullptr;
+    }
+    while (order < next)
+      order_locks[++order].lock();
+  }
+  const size_t locked_order = order;
+  ListNode *node = pop_free(order);
+
+  // split
+  auto index = index_to_node(node, order);
+  if (order < k_maximum_order) {
+    to_split(parent(index));
+  }
+
+  while (order > required_order) {
+    const auto index_here = index_to_node(node, order);
+    to_split(index_here);
+    order_stats[order].splits++;
+    order--;
+
+    push_free(order, node_to_index(child_right(index_here), order));
+
+    node = node_to_index(child_left(index_here), order);
+  }
+  unlock_orders(required_order, locked_order);
+  // Guardar metadatos externamente
+  void *ptr = reinterpret_cast<void *>(node);
+  set_order(ptr, required_order);
+  return ptr;
+}
+
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+void Buddy_allocation<HeapSize, MinBlock, Concurrent>::free(void *ptr) {
+  if (!ptr)
+    return;
+
+  if (!owns(ptr))
+    return;
+
+  // recuperacion de metadata
+  const size_t order = get_order(ptr);
+  if (lazy_slack && defer(reinterpret_cast<ListNode *>(ptr), order))
+    return;
+  free_block(reinterpret_cast<ListNode *>(ptr), order);
+}
+
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+void Buddy_allocation<HeapSize, MinBlock, Concurrent>::free(void *ptr,
+                                                            size_t size) {
+  if (!ptr || !owns(ptr))
+    return;
+
+  const size_t order = log2(std::max(size, MinBlock)) - log2(MinBlock);
+#ifdef BUDDY_DEBUG
+  assert(order == get_order(ptr) && "free con un tamano que no es el pedido");
+#endif
+  if (lazy_slack && defer(reinterpret_cast<ListNode *>(ptr), order))
+    return;
+  free_block(reinterpret_cast<ListNode *>(ptr), order);
+}
+
+// Guarda el bloque sin coalescer si su orden aun no agoto el margen
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+bool Buddy_allocation<HeapSize, MinBlock, Concurrent>::defer(ListNode *node,
+                                                             size_t order) {
+  std::lock_guard<Order_mutex> guard(order_locks[order]);
+  if (deferred_counts[order] >= lazy_slack)
+    return false;
+  *reinterpret_cast<void **>(node) = deferred_lists[order];
+  deferred_lists[order] = node;
+  deferred_counts[order]++;
+  order_stats[order].deferred++;
+  atomic_add(deferred_bytes, block_size(order));
+  atomic_or(deferred_orders, uint64_t(1) << order);
+  return true;
+}
+
+// El bloque diferido conserva su orden en los metadatos: se entrega tal cual
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+void *Buddy_allocation<HeapSize, MinBlock, Concurrent>::reuse_deferred(
+    size_t order) {
+  std::lock_guard<Order_mutex> guard(order_locks[order]);
+  void *ptr = deferred_lists[order];
+  if (!ptr)
+    return nullptr;
+  deferred_lists[order] = *static_cast<void **>(ptr);
+  if (--deferred_counts[order] == 0)
+    atomic_and(deferred_orders, ~(uint64_t(1) << order));
+  order_stats[order].reused++;
+  atomic_add(deferred_bytes, -block_size(order));
+  return ptr;
+}
+
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+void Buddy_allocation<HeapSize, MinBlock, Concurrent>::flush() {
+  for (size_t order = 0; order < k_order_count; ++order) {
+    void *list;
+    {
+      std::lock_guard<Order_mutex> guard(order_locks[order]);
+      list = deferred_lists[order];
+      deferred_lists[order] = nullptr;
+      atomic_add(deferred_bytes, -deferred_counts[order] * block_size(order));
+      deferred_counts[order] = 0;
+      atomic_and(deferred_orders, ~(uint64_t(1) << order));
+    }
+    while (list) {
+      void *next = *static_cast<void **>(list);
+      free_block(static_cast<ListNode *>(list), order);
+      list = next;
+    }
+  }
+}
+
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+Coalesce_stats
+Buddy_allocation<HeapSize, MinBlock, Concurrent>::coalesce_stats() const {
+  Coalesce_stats stats;
+  for (const Coalesce_stats &order : order_stats) {
+    stats.splits += load(order.splits);
+    stats.merges += load(order.merges);
+    stats.deferred += load(order.deferred);
+    stats.reused += load(order.reused);
+  }
+  return stats;
+}
+
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+void Buddy_allocation<HeapSize, MinBlock, Concurrent>::free_block(
+    ListNode *node, size_t stored_order) {
+  size_t order = stored_order;
+  auto index = index_to_node(node, order);
+  // Bytes del bloque resultante que aun pueden estar comprometidos: los
+  // hermanos libres de orden >= release_order ya devolvieron su cuerpo
+  size_t fresh = block_size(order);
+
+  // Coalescer tomando los cerrojos de forma ascendente
+  order_locks[order].lock();
+  while (order < k_maximum_order && can_split(parent(index))) {
+    auto sibling_node = node_to_index(sibling(index), order);
+    remove_free(order, sibling_node);
+    order_stats[order].merges++;
+    fresh += order >= release_order ? release_kept : block_size(order);
+    index = parent(index);
+    to_split(index);
+    order++;
+    order_locks[order].lock();
+    node = node_to_index(index, order);
+  }
+
+  if (order >= release_order)
+    release_pages(node, order, fresh);
+  push_free(order, node);
+  if (order < k_maximum_order)
+    to_split(parent(index));
+  unlock_orders(stored_order, order);
+}
+
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+size_t Buddy_allocation<HeapSize, MinBlock, Concurrent>::malloc_bulk(
+    size_t count, size_t size, void **out) {
+  if (count == 0 || size == 0 || size > k_size)
+    return 0;
+
+  const size_t required_order =
+      log2(std::max(size, MinBlock)) - log2(MinBlock);
+  size_t done = 0;
+
+  order_locks[required_order].lock();
+  // Primero los bloques que ya son del orden pedido
+  while (done < count && !order_empty(required_order)) {
+    ListNode *node = pop_free(required_order);
+    if (required_order < k_maximum_order)
+      to_split(parent(index_to_node(node, required_order)));
+    set_order(node, required_order);
+    out[done++] = node;
+  }
+
+  // Despues se trocean bloques mayores: el menor que cubra todo lo que falta
+  // o, si no hay ninguno, el mayor disponible
+  while (done < count && required_order < k_maximum_order) {
+    const uint64_t larger =
+        load(free_orders) & (~uint64_t(0) << (required_order + 1));
+    if (!larger)
+      break;
+    const size_t target =
+        std::min(required_order + log2(count - done), k_maximum_order);
+    const uint64_t covering = larger & (~uint64_t(0) << target);
+    const size_t order = covering ? __builtin_ctzll(covering)
+                                  : 63 - __builtin_clzll(larger);
+
+    for (size_t o = required_order + 1; o <= order; ++o)
+      order_locks[o].lock();
+    // Pista obsoleta (solo en modo concurrente): lo que falte ira por malloc
+    if (order_empty(order)) {
+      unlock_orders(required_order + 1, order);
+      break;
+    }
+    done += carve(pop_free(order), order, required_order, count - done,
+                  out + done);
+    unlock_orders(required_order + 1, order);
+  }
+  order_locks[required_order].unlock();
+
+  for (void *ptr; done < count && (ptr = malloc(size));)
+    out[done++] = ptr;
+  return done;
+}
+
+// Reparte los primeros bloques de required_order de un bloque de orden order
+// recien sacado de su lista y devuelve el resto a las listas en trozos
+// alineados lo mas grandes posible. Solo los trozos libres (siempre hijos
+// derechos) cambian bits de split_nodes; los nodos intermedios quedan igual
+// que tras una cadena de splits.
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+size_t Buddy_allocation<HeapSize, MinBlock, Concurrent>::carve(
+    ListNode *node, size_t order, size_t required_order, size_t count,
+    void **out) {
+  if (order < k_maximum_order)
+    to_split(parent(index_to_node(node, order)));
+
+  char *base = reinterpret_cast<char *>(node);
+  const size_t total = size_t(1) << (order - required_order);
+  const size_t taken = std::min(count, total);
+  for (size_t i = 0; i < taken; ++i) {
+    out[i] = base + i * block_size(required_order);
+    set_order(out[i], required_order);
+  }
+
+  release_tail(base, order, required_order, taken);
+  return taken;
+}
+
+// Devuelve a las listas la cola de un bloque de orden order a partir de
+// taken unidades de unit_order, en trozos alineados lo mas grandes posible.
+// Cada trozo es hijo derecho de un nodo cuyo hijo izquierdo sigue ocupado:
+// no coalesce y solo cambia el bit de split_nodes de su padre. Hay que tener
+// tomados los cerrojos de los ordenes unit_order .. order - 1.
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+void Buddy_allocation<HeapSize, MinBlock, Concurrent>::release_tail(
+    char *base, size_t order, size_t unit_order, size_t taken) {
+  const size_t total = size_t(1) << (order - unit_order);
+  for (size_t pos = taken; pos < total;) {
+    const size_t shift = __builtin_ctzll(pos);
+    const size_t free_order = unit_order + shift;
+    auto rest = reinterpret_cast<ListNode *>(base + pos * block_size(unit_order));
+    push_free(free_order, rest);
+    to_split(parent(index_to_node(rest, free_order)));
+    pos += size_t(1) << shift;
+  }
+}
+
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+void Buddy_allocation<HeapSize, MinBlock, Concurrent>::free_bulk(void **ptrs,
+                                                                 size_t n) {
+  // Lo habitual es devolver lo que dio malloc_bulk, que ya va en orden
+  if (!std::is_sorted(ptrs, ptrs + n))
+    std::sort(ptrs, ptrs + n);
+
+  // Pila de bloques pendientes: cada bloque nuevo se une con la cima mientras
+  // sean hermanos del mismo orden. Una entrada solo sigue en la pila si es
+  // hijo izquierdo y el bloque siguiente cae dentro de su hermano, asi que
+  // los ordenes bajan estrictamente hacia la cima y caben k_order_count + 1.
+  struct Pending {
+    char *ptr;
+    size_t order;
+  };
+  Pending stack[k_order_count + 1];
+  size_t top = 0;
+  const auto waits_for = [&](const Pending &block, const char *ptr) {
+    return block.order < k_maximum_order &&
+           (block.ptr - heap_base) % block_size(block.order + 1) == 0 &&
+           ptr >= block.ptr + block_size(block.order) &&
+           ptr < block.ptr + block_size(block.order + 1);
+  };
+
+  const void *previous = nullptr;
+  for (size_t i = 0; i < n; ++i) {
+    if (!owns(ptrs[i]) || ptrs[i] == previous)
+      continue;
+    previous = ptrs[i];
+    char *ptr = static_cast<char *>(ptrs[i]);
+    while (top && !waits_for(stack[top - 1], ptr)) {
+      --top;
+      free_block(reinterpret_cast<ListNode *>(stack[top].ptr),
+                 stack[top].order);
+    }
+    stack[top++] = {ptr, get_order(ptr)};
+    while (top >= 2 && stack[top - 2].order == stack[top - 1].order &&
+           stack[top - 1].ptr ==
+               stack[top - 2].ptr + block_size(stack[top - 2].order)) {
+      --top;
+      stack[top - 1].order++;
+    }
+  }
+  while (top) {
+    --top;
+    free_block(reinterpret_cast<ListNode *>(stack[top].ptr), stack[top].order);
+  }
+}
+
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+void *Buddy_allocation<HeapSize, MinBlock, Concurrent>::malloc_exact(
+    size_t size) {
+  void *ptr = malloc(size);
+  if (!ptr)
+    return nullptr;
+
+  const size_t order = log2(std::max(size, MinBlock)) - log2(MinBlock);
+  const size_t granules = (size + MinBlock - 1) / MinBlock;
+  if (granules == size_t(1) << order)
+    return ptr;
+
+  // La cola solo tiene trozos de orden ctz(granules) .. order - 1
+  const size_t lowest = __builtin_ctzll(granules);
+  for (size_t o = lowest; o < order; ++o)
+    order_locks[o].lock();
+  release_tail(static_cast<char *>(ptr), order, 0, granules);
+  unlock_orders(lowest, order - 1);
+
+  // Cada trozo conservado queda anotado como un bloque asignado normal
+  char *piece = static_cast<char *>(ptr);
+  for (size_t o = order; o-- > 0;) {
+    if (granules >> o & 1) {
+      set_order(piece, o);
+      piece += block_size(o);
+    }
+  }
+  return ptr;
+}
+
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+void Buddy_allocation<HeapSize, MinBlock, Concurrent>::free_exact(void *ptr,
+                                                                  size_t size) {
+  if (!ptr || !owns(ptr))
+    return;
+
+  const size_t granules = (size + MinBlock - 1) / MinBlock;
+  if ((granules & (granules - 1)) == 0) {
+    free(ptr, size);
+    return;
+  }
+  // Del trozo mas pequeno (el ultimo) al mayor: cada uno coalesce con la
+  // cola libre que tiene a su derecha
+  char *end = static_cast<char *>(ptr) + granules * MinBlock;
+  for (size_t o = 0; o < k_order_count; ++o) {
+    if (!(granules >> o & 1))
+      continue;
+    end -= block_size(o);
+#ifdef BUDDY_DEBUG
+    assert(get_order(end) == o && "free_exact con un tamano que no es el pedido");
+#endif
+    free_block(reinterpret_cast<ListNode *>(end), o);
+  }
+}
+
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+void *Buddy_allocation<HeapSize, MinBlock, Concurrent>::aligned_malloc(
+    size_t size, size_t alignment) {
+  if (alignment == 0)
+    alignment = MinBlock;
+  if (alignment & (alignment - 1) || alignment > k_size)
+    return nullptr;
+  if (size == 0)
+    return nullptr;
+  // En una region ajena la alineacion es relativa a su base
+  if (reinterpret_cast<uintptr_t>(heap_base) & (alignment - 1))
+    return nullptr;
+  return malloc(std::max(size, alignment));
+}
+
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+void *Buddy_allocation<HeapSize, MinBlock, Concurrent>::realloc(void *ptr,
+                                                               size_t size) {
+  if (!ptr)
+    return malloc(size);
+  if (!owns(ptr))
+    return nullptr;
+  if (size == 0) {
+    free(ptr);
+    return nullptr;
+  }
+  if (size > k_size)
+    return nullptr;
+
+  const size_t order = get_order(ptr);
+  const size_t new_order = log2(std::max(size, MinBlock)) - log2(MinBlock);
+  if (new_order == order)
+    return ptr;
+  if (new_order < order) {
+    shrink_in_place(ptr, order, new_order);
+    atomic_add(shrunk_in_place, size_t(1));
+    return ptr;
+  }
+  if (grow_in_place(ptr, order, new_order)) {
+    atomic_add(grown_in_place, size_t(1));
+    return ptr;
+  }
+
+  void *moved_ptr = malloc(size);
+  if (!moved_ptr)
+    return nullptr;
+  std::memcpy(moved_ptr, ptr, block_size(order));
+  free(ptr);
+  atomic_add(moved, size_t(1));
+  return moved_ptr;
+}
+
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+Realloc_stats
+Buddy_allocation<HeapSize, MinBlock, Concurrent>::realloc_stats() const {
+  Realloc_stats stats;
+  stats.grown_in_place = load(grown_in_place);
+  stats.shrunk_in_place = load(shrunk_in_place);
+  stats.moved = load(moved);
+  return stats;
+}
+
+// Para crecer de order a new_order el bloque debe estar alineado a
+// block_size(new_order) (hijo izquierdo en todos los niveles) y cada hermano
+// derecho debe estar libre entero. Como el bloque y sus ascendientes no estan
+// en ninguna lista, el bit de split_nodes del padre basta para saberlo.
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+bool Buddy_allocation<HeapSize, MinBlock, Concurrent>::grow_in_place(
+    void *ptr, size_t order, size_t new_order) {
+  char *base = static_cast<char *>(ptr);
+  if ((base - heap_base) % block_size(new_order))
+    return false;
+
+  for (size_t o = order; o < new_order; ++o)
+    order_locks[o].lock();
+  for (size_t o = order; o < new_order; ++o) {
+    if (!can_split(parent(index_to_node(
+            reinterpret_cast<ListNode *>(base), o)))) {
+      unlock_orders(order, new_order - 1);
+      return false;
+    }
+  }
+  for (size_t o = order; o < new_order; ++o) {
+    remove_free(o, reinterpret_cast<ListNode *>(base + block_size(o)));
+    to_split(parent(index_to_node(reinterpret_cast<ListNode *>(base), o)));
+  }
+  set_order(ptr, new_order);
+  unlock_orders(order, new_order - 1);
+  return true;
+}
+
+// Las mitades derechas que sobran pasan a sus listas; no pueden coalescer
+// porque su hermano izquierdo sigue asignado.
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+void Buddy_allocation<HeapSize, MinBlock, Concurrent>::shrink_in_place(
+    void *ptr, size_t order, size_t new_order) {
+  char *base = static_cast<char *>(ptr);
+  for (size_t o = new_order; o < order; ++o)
+    order_locks[o].lock();
+  set_order(ptr, new_order);
+  for (size_t o = new_order; o < order; ++o) {
+    auto right = reinterpret_cast<ListNode *>(base + block_size(o));
+    // Su hermano es la mitad que se conserva: no coalesce, pero devuelve
+    // sus paginas como un free normal del mismo orden
+    if (o >= release_order)
+      release_pages(right, o, block_size(o));
+    push_free(o, right);
+    to_split(parent(index_to_node(right, o)));
+  }
+  unlock_orders(new_order, order - 1);
+}
+
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+uint64_t Buddy_allocation<HeapSize, MinBlock, Concurrent>::encode_link(
+    const ListNode *node) const {
+  if (node >= free_lists && node < free_lists + k_order_count)
+    return k_size + (node - free_lists);
+  return reinterpret_cast<const char *>(node) - heap_base;
+}
+
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+ListNode *
+Buddy_allocation<HeapSize, MinBlock, Concurrent>::decode_link(uint64_t link) {
+  if (link >= k_size)
+    return &free_lists[link - k_size];
+  return reinterpret_cast<ListNode *>(heap_base + link);
+}
+
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+bool Buddy_allocation<HeapSize, MinBlock, Concurrent>::save(const char *path) {
+  if (!heap_reserved)
+    return false;
+  // Los bloques diferidos no estan en ninguna lista: se coalescen antes
+  if (lazy_slack)
+    flush();
+
+  Snapshot_writer out(path);
+  Snapshot_header header = {};
+  std::copy(std::begin(k_snapshot_magic), std::end(k_snapshot_magic),
+            header.magic);
+  header.heap_size = k_size;
+  header.min_block = MinBlock;
+  out.section(sizeof(header));
+  header.split_offset = out.section(k_split_bytes);
+  header.ends_offset = out.section(k_order_words * sizeof(uint64_t));
+  header.large_offset = out.section(k_order_words);
+  header.heap_offset = out.section(k_size);
+  if (bitmap_only) {
+    header.free_map_offset = out.section(free_map_bytes);
+    out.write(header.free_map_offset, free_map_words, free_map_bytes);
+  }
+  out.write(header.split_offset, split_nodes, k_split_bytes);
+  out.write(header.ends_offset, order_ends, k_order_words * sizeof(uint64_t));
+  out.write(header.large_offset, large_orders, k_order_words);
+  out.write(header.heap_offset, heap_base, k_size);
+
+  // En la copia cada nodo libre lleva sus enlaces como desplazamientos
+  for (size_t order = 0; order < k_order_count; ++order) {
+    const ListNode *list = &free_lists[order];
+    header.heads[order][0] = encode_link(list->next);
+    header.heads[order][1] = encode_link(list->prev);
+    for (const ListNode *node = list->next; node != list; node = node->next) {
+      const uint64_t links[2] = {encode_link(node->prev),
+                                 encode_link(node->next)};
+      static_assert(sizeof(links) == sizeof(ListNode),
+                    "ListNode no son dos punteros");
+      out.write(header.heap_offset + encode_link(node), links, sizeof(links));
+    }
+  }
+  out.write(0, &header, sizeof(header));
+  return out.finish();
+}
+
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+bool Buddy_allocation<HeapSize, MinBlock, Concurrent>::restore(
+    const char *path) {
+  if (!heap_reserved)
+    return false;
+  Snapshot_reader in(path);
+  Snapshot_header header;
+  if (!in.ok() || !in.read(0, &header, sizeof(header)))
+    return false;
+  if (!std::equal(std::begin(k_snapshot_magic), std::end(k_snapshot_magic),
+                  header.magic) ||
+      header.heap_size != k_size || header.min_block != MinBlock ||
+      header.heap_offset + k_size > in.size() ||
+      (header.free_map_offset != 0) != bitmap_only)
+    return false;
+
+  // Todo se lee y se proyecta aparte antes de tocar el estado actual
+  std::vector<uint8_t> saved_split(k_split_bytes);
+  std::vector<uint64_t> saved_ends(k_order_words);
+  std::vector<uint8_t> saved_large(k_order_words);
+  std::vector<uint64_t> saved_map(
+      bitmap_only ? free_map_bytes / sizeof(uint64_t) : 0);
+  if (!in.read(header.split_offset, saved_split.data(), k_split_bytes) ||
+      !in.read(header.ends_offset, saved_ends.data(),
+               k_order_words * sizeof(uint64_t)) ||
+      !in.read(header.large_offset, saved_large.data(), k_order_words) ||
+      (bitmap_only &&
+       !in.read(header.free_map_offset, saved_map.data(), free_map_bytes)))
+    return false;
+  auto heap = static_cast<char *>(vmem::reserve_aligned(k_size, k_size));
+  if (!in.map(header.heap_offset, heap, k_size)) {
+    vmem::release(heap, k_size);
+    return false;
+  }
+
+  // A partir de aqui nada puede fallar
+  vmem::release(heap_base, heap_reserved);
+  heap_base = heap;
+  heap_reserved = k_size;
+  heap_backing = vmem::Backing::normal;
+  heap_from_file = true;
+  if (release_order < k_order_count) {
+    // La proyeccion del fichero es de paginas base
+    release_granularity = vmem::page_size();
+    release_kept = bitmap_only ? 0 : release_granularity;
+  }
+  std::copy(saved_split.begin(), saved_split.end(), split_nodes);
+  std::copy(saved_ends.begin(), saved_ends.end(), order_ends);
+  std::copy(saved_large.begin(), saved_large.end(), large_orders);
+  std::copy(saved_map.begin(), saved_map.end(), free_map_words);
+
+  // Reconstruir los punteros de las listas y lo que se deriva de ellas
+  free_orders = 0;
+  listed_bytes = 0;
+  if (bitmap_only) {
+    for (size_t order = 0; order < k_order_count; ++order) {
+      if (free_maps[order].any())
+        free_orders |= uint64_t(1) << order;
+      if (count_listed)
+        listed_bytes += free_maps[order].count() * block_size(order);
+    }
+  } else if (address_ordered) {
+    std::fill(free_map_words,
+              free_map_words + free_map_bytes / sizeof(uint64_t), 0);
+  }
+  for (size_t order = 0; order < k_order_count; ++order) {
+    ListNode *list = &free_lists[order];
+    list->next = decode_link(header.heads[order][0]);
+    list->prev = decode_link(header.heads[order][1]);
+    for (ListNode *node = list->next; node != list; node = node->next) {
+      node->prev = decode_link(reinterpret_cast<uint64_t>(node->prev));
+      node->next = decode_link(reinterpret_cast<uint64_t>(node->next));
+      if (address_ordered)
+        free_maps[order].set(position(node, order));
+      if (count_listed)
+        listed_bytes += block_size(order);
+    }
+    if (!order_empty(order))
+      free_orders |= uint64_t(1) << order;
+    deferred_lists[order] = nullptr;
+    deferred_counts[order] = 0;
+    order_stats[order] = Coalesce_stats();
+  }
+  deferred_orders = 0;
+  deferred_bytes = 0;
+  released = 0;
+  grown_in_place = shrunk_in_place = moved = 0;
+  return true;
+}
+
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+void Buddy_allocation<HeapSize, MinBlock, Concurrent>::release_pages(
+    ListNode *node, size_t order, size_t fresh) {
+  // La primera pagina se conserva si alli vive el ListNode del bloque libre
+  char *body = reinterpret_cast<char *>(node) + release_kept;
+  const size_t size = block_size(order) - release_kept;
+  if (heap_from_file
+          ? vmem::discard_anonymous(body, size, release_granularity)
+          : vmem::discard(body, size, release_granularity, release_lazy))
+    atomic_add(released, fresh > release_kept ? fresh - release_kept : 0);
+}
+
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+size_t Buddy_allocation<HeapSize, MinBlock, Concurrent>::index_to_node(
+    ListNode *node, size_t order) {
+  return offset_to_index(reinterpret_cast<char *>(node) - heap_base, order);
+}
+
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+ListNode *Buddy_allocation<HeapSize, MinBlock, Concurrent>::node_to_index(
+    size_t index, size_t order) {
+  return reinterpret_cast<ListNode *>(heap_base +
+                                      index_to_offset(index, order));
+}
+
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+bool Buddy_allocation<HeapSize, MinBlock, Concurrent>::can_split(
+    size_t i) const {
+  return (load(split_nodes[i / 8]) >> (i % 8)) & 1;
+}
+
+template <size_t HeapSize, size_t MinBlock, bool Concurrent>
+void Buddy_allocation<HeapSize, MinBlock, Concurrent>::to_split(size_t i) {
+  atomic_xor(split_nodes[i / 8], static_cast<uint8_t>(1 << (i % 8)));
+}
+
+// La configuracion por defecto se instancia una sola vez en src/buddy.cpp
+extern template class Buddy_allocation<64 * 1024 * 1024>;
+
 #endif // BUDDY_H
@@ -0,0 +1,319 @@
+#pragma once
+#ifndef LFBUDDY_H
+#define LFBUDDY_H
+
+#include "buddy.h"
+#include "vmem.h"
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+// Motor buddy sin cerrojos (non-blocking buddy system, Marotta et al.).
+// En lugar de listas doblemente enlazadas dentro de los bloques libres, el
+// estado vive en un arbol implicito con un byte por nodo que solo se
+// modifica con CAS:
+//   OCC            el nodo entero esta asignado
+//   OCC_LEFT/RIGHT hay algo asignado en el subarbol izquierdo/derecho
+//   COAL_LEFT/RIGHT ese subarbol se esta liberando (coalescencia en curso)
+// malloc busca en el nivel del orden pedido un nodo a 0, lo marca ocupado y
+// sube marcando ancestros; si encuentra un ancestro OCC deshace lo marcado.
+// free marca COAL hacia arriba, libera el nodo y luego limpia las marcas
+// mientras el hermano no este ocupado.
+template <size_t HeapSize, size_t MinBlock = Min_alloc> class Lockfree_buddy {
+public:
+  static constexpr size_t k_size = HeapSize;
+  static constexpr size_t k_min_block = MinBlock;
+  static constexpr bool k_concurrent = true;
+  static constexpr size_t k_maximum_order = log2(k_size) - log2(MinBlock);
+
+  explicit Lockfree_buddy(const Buddy_options &options = Buddy_options());
+  // Sobre memoria ya proyectada (Shared_buddy): heap de k_size bytes,
+  // tree_bytes() de arbol y order_bytes() de ordenes, a cero o con el estado
+  // que dejo otra instancia. El destructor deshace esas proyecciones.
+  Lockfree_buddy(char *heap, uint8_t *tree, uint8_t *orders);
+  ~Lockfree_buddy();
+  Lockfree_buddy(const Lockfree_buddy &) = delete;
+  Lockfree_buddy &operator=(const Lockfree_buddy &) = delete;
+
+  void *malloc(const size_t);
+  void free(void *);
+  // free con el tamano pedido: no lee el orden guardado
+  void free(void *, size_t size);
+  // Sin listas libres donde devolver la cola: la reserva exacta es el bloque
+  // potencia de 2 entero
+  void *malloc_exact(const size_t size) { return malloc(size); }
+  void free_exact(void *ptr, size_t size) { free(ptr, size); }
+  size_t exact_size(void *ptr, size_t) const { return usable_size(ptr); }
+
+  char *heap_base = nullptr;
+
+  bool owns(const void *ptr) const {
+    return ptr >= heap_base && ptr < heap_base + k_size;
+  }
+  size_t usable_size(void *ptr) const {
+    return MinBlock << orders[offset_of(ptr) / MinBlock];
+  }
+  bool empty() const { return load(tree[1]) == 0; }
+  // Sin resumen de ordenes libres: se baja por el arbol desde la raiz hasta
+  // el primer nivel con un nodo libre, podando los subarboles que no pueden
+  // mejorar lo ya encontrado. Con otros hilos trabajando es orientativo.
+  size_t largest_free_block() const { return largest_below(1, 0, 0); }
+  bool can_allocate(size_t size) const {
+    return size && size <= k_size && largest_free_block() >= size;
+  }
+  size_t reserved_bytes() const;
+  size_t resident_bytes() const;
+  // Un byte por nodo del arbol mas uno por granulo
+  static constexpr size_t metadata_bytes() {
+    return k_tree_bytes + k_order_bytes;
+  }
+  static constexpr size_t managed_bytes() { return k_size; }
+  static constexpr size_t tree_bytes() { return k_tree_bytes; }
+  static constexpr size_t order_bytes() { return k_order_bytes; }
+  size_t released_bytes() const { return 0; }
+
+private:
+  static_assert((HeapSize & (HeapSize - 1)) == 0,
+                "HeapSize no es potencia de 2");
+  static_assert((MinBlock & (MinBlock - 1)) == 0,
+                "MinBlock no es potencia de 2");
+
+  static constexpr uint8_t OCC_RIGHT = 0x1;
+  static constexpr uint8_t OCC_LEFT = 0x2;
+  static constexpr uint8_t COAL_RIGHT = 0x4;
+  static constexpr uint8_t COAL_LEFT = 0x8;
+  static constexpr uint8_t OCC = 0x10;
+  static constexpr uint8_t BUSY = OCC | OCC_LEFT | OCC_RIGHT;
+
+  // Arbol 1-indexado: raiz = 1, hijos 2n y 2n + 1 (los izquierdos son pares)
+  static constexpr size_t k_tree_bytes = size_t(2) << k_maximum_order;
+  static constexpr size_t k_order_bytes = k_size / MinBlock;
+
+  uint8_t *tree = nullptr;
+  // Orden de cada bloque asignado, indexado por granulo de MinBlock bytes
+  uint8_t *orders = nullptr;
+  vmem::Backing heap_backing = vmem::Backing::normal;
+  size_t heap_reserved = k_size;
+
+  static constexpr size_t depth(size_t n) {
+    return std::numeric_limits<size_t>::digits - 1 - __builtin_clzll(n);
+  }
+  static constexpr size_t parent(size_t n) { return n >> 1; }
+  // Bits del lado de child en su padre, y del lado de su hermano
+  static constexpr uint8_t side(uint8_t left_bit, size_t child) {
+    return left_bit >> (child & 1);
+  }
+  static constexpr uint8_t buddy_side(uint8_t right_bit, size_t child) {
+    return right_bit << (child & 1);
+  }
+
+  static uint8_t load(const uint8_t &state) {
+    return __atomic_load_n(&state, __ATOMIC_SEQ_CST);
+  }
+  static bool cas(uint8_t &state, uint8_t expected, uint8_t desired) {
+    return __atomic_compare_exchange_n(&state, &expected, desired, false,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+  }
+
+  size_t offset_of(const void *ptr) const {
+    return static_cast<const char *>(ptr) - heap_base;
+  }
+  size_t largest_below(size_t n, size_t level, size_t best) const;
+  size_t try_alloc(size_t n);
+  void free_node(size_t n, size_t upper_bound);
+  void unmark(size_t n, size_t upper_bound);
+};
+
+// Configuracion equivalente a Default_buddy
+using Default_lockfree_buddy = Lockfree_buddy<64 * 1024 * 1024>;
+
+template <size_t HeapSize, size_t MinBlock>
+Lockfree_buddy<HeapSize, MinBlock>::Lockfree_buddy(
+    const Buddy_options &options) {
+  heap_base = static_cast<char *>(vmem::reserve_heap(
+      k_size, options.huge_pages, heap_reserved, heap_backing));
+  tree = static_cast<uint8_t *>(vmem::reserve(k_tree_bytes));
+  orders = static_cast<uint8_t *>(vmem::reserve(k_order_bytes));
+}
+
+template <size_t HeapSize, size_t MinBlock>
+Lockfree_buddy<HeapSize, MinBlock>::Lockfree_buddy(char *heap, uint8_t *tree,
+                                                   uint8_t *orders)
+    : heap_base(heap), tree(tree), orders(orders) {}
+
+template <size_t HeapSize, size_t MinBlock>
+Lockfree_buddy<HeapSize, MinBlock>::~Lockfree_buddy() {
+  vmem::release(heap_base, heap_reserved);
+  vmem::release(tree, k_tree_bytes);
+  vmem::release(orders, k_order_bytes);
+}
+
+template <size_t HeapSize, size_t MinBlock>
+size_t Lockfree_buddy<HeapSize, MinBlock>::reserved_bytes() const {
+  return heap_reserved + k_tree_bytes + k_order_bytes;
+}
+
+template <size_t HeapSize, size_t MinBlock>
+size_t Lockfree_buddy<HeapSize, MinBlock>::resident_bytes() const {
+  return vmem::resident_bytes(heap_base, heap_reserved) +
+         vmem::resident_bytes(tree, k_tree_bytes) +
+         vmem::resident_bytes(orders, k_order_bytes);
+}
+
+// Mayor bloque libre en el subarbol de n (nivel level) si supera best. Un
+// lado sin OCC_LEFT/RIGHT en el padre es un hijo libre entero; un lado que
+// se esta liberando (COAL) aun cuenta como ocupado.
+template <size_t HeapSize, size_t MinBlock>
+size_t Lockfree_buddy<HeapSize, MinBlock>::largest_below(size_t n,
+                                                         size_t level,
+                                                         size_t best) const {
+  const size_t size = k_size >> level;
+  if (size <= best)
+    return best;
+  const uint8_t value = load(tree[n]);
+  if (value == 0)
+    return size;
+  if ((value & OCC) || level == k_maximum_order)
+    return best;
+  if ((value & (OCC_LEFT | OCC_RIGHT)) != (OCC_LEFT | OCC_RIGHT))
+    return size / 2;
+  best = largest_below(2 * n, level + 1, best);
+  return largest_below(2 * n + 1, level + 1, best);
+}
+
+template <size_t HeapSize, size_t MinBlock>
+void *Lockfree_buddy<HeapSize, MinBlock>::malloc(const size_t request) {
+  if (request == 0 || request > k_size)
+    return nullptr;
+
+  const size_t order = log2(std::max(request, MinBlock)) - log2(MinBlock);
+  const size_t level = k_maximum_order - order;
+  const size_t first = size_t(1) << level;
+
+  // Cada hilo recorre el nivel desde su propia posicion para no competir
+  // siempre por los mismos nodos
+  static thread_local size_t hint =
+      std::hash<std::thread::id>()(std::this_thread::get_id());
+  const size_t start = hint % first;
+
+  for (size_t i = 0; i < first;) {
+    const size_t n = first + (start + i) % first;
+    if (load(tree[n]) != 0) {
+      ++i;
+      continue;
+    }
+    const size_t failed = try_alloc(n);
+    if (!failed) {
+      hint = n - first;
+      const size_t offset = (n - first) << log2(MinBlock) << order;
+      orders[offset / MinBlock] = static_cast<uint8_t>(order);
+      return heap_base + offset;
+    }
+    // Saltar el resto del subarbol del nodo que impidio la asignacion
+    const size_t below = level - depth(failed);
+    const size_t end = (failed + 1) << below;
+    i += end > n ? end - n : 1;
+  }
+  return nullptr;
+}
+
+template <size_t HeapSize, size_t MinBlock>
+size_t Lockfree_buddy<HeapSize, MinBlock>::try_alloc(size_t n) {
+  if (!cas(tree[n], 0, BUSY))
+    return n;
+
+  size_t current = n;
+  while (current > 1) {
+    const size_t child = current;
+    current = parent(current);
+    uint8_t value, updated;
+    do {
+      value = load(tree[current]);
+      if (value & OCC) {
+        // Un ancestro esta asignado entero: deshacer las marcas puestas
+        free_node(n, depth(child));
+        return current;
+      }
+      updated = (value & ~side(COAL_LEFT, child)) | side(OCC_LEFT, child);
+    } while (!cas(tree[current], value, updated));
+  }
+  return 0;
+}
+
+template <size_t HeapSize, size_t MinBlock>
+void Lockfree_buddy<HeapSize, MinBlock>::free(void *ptr) {
+  if (!owns(ptr))
+    return;
+
+  const size_t offset = offset_of(ptr);
+  const size_t order = orders[offset / MinBlock];
+  const size_t level = k_maximum_order - order;
+  free_node((size_t(1) << level) + (offset >> log2(MinBlock) >> order), 0);
+}
+
+template <size_t HeapSize, size_t MinBlock>
+void Lockfree_buddy<HeapSize, MinBlock>::free(void *ptr, size_t size) {
+  if (!owns(ptr))
+    return;
+
+  const size_t offset = offset_of(ptr);
+  const size_t order = log2(std::max(size, MinBlock)) - log2(MinBlock);
+#ifdef BUDDY_DEBUG
+  assert(order == orders[offset / MinBlock] &&
+         "free con un tamano que no es el pedido");
+#endif
+  const size_t level = k_maximum_order - order;
+  free_node((size_t(1) << level) + (offset >> log2(MinBlock) >> order), 0);
+}
+
+template <size_t HeapSize, size_t MinBlock>
+void Lockfree_buddy<HeapSize, MinBlock>::free_node(size_t n,
+                                                   size_t upper_bound) {
+  if (depth(n) == upper_bound) {
+    __atomic_store_n(&tree[n], 0, __ATOMIC_SEQ_CST);
+    return;
+  }
+
+  // Fase 1: anunciar la coalescencia en los ancestros hasta upper_bound o
+  // hasta uno cuyo otro subarbol siga ocupado
+  size_t runner = n;
+  size_t current = parent(n);
+  while (depth(runner) > upper_bound) {
+    const uint8_t old = __atomic_fetch_or(
+        &tree[current], side(COAL_LEFT, runner), __ATOMIC_SEQ_CST);
+    if ((old & buddy_side(OCC_RIGHT, runner)) &&
+        !(old & buddy_side(COAL_RIGHT, runner)))
+      break;
+    runner = current;
+    current = parent(current);
+  }
+
+  // Fase 2: liberar el nodo y limpiar las marcas que sigan anunciadas
+  __atomic_store_n(&tree[n], 0, __ATOMIC_SEQ_CST);
+  unmark(n, upper_bound);
+}
+
+template <size_t HeapSize, size_t MinBlock>
+void Lockfree_buddy<HeapSize, MinBlock>::unmark(size_t n,
+                                                size_t upper_bound) {
+  size_t current = n;
+  size_t child;
+  uint8_t updated;
+  do {
+    child = current;
+    current = parent(current);
+    uint8_t value;
+    do {
+      value = load(tree[current]);
+      // Otra asignacion ya reclamo este lado: se detiene la limpieza
+      if (!(value & side(COAL_LEFT, child)))
+        return;
+      updated = value & ~(side(OCC_LEFT, child) | side(COAL_LEFT, child));
+    } while (!cas(tree[current], value, updated));
+  } while (depth(current) > upper_bound &&
+           !(updated & buddy_side(OCC_RIGHT, child)));
+}
+
+#endif // LFBUDDY_H
@@ -2,8 +2,9 @@
 #ifndef LINEAR_H
 #define LINEAR_H
 
-#include "buddy.h"
+#include <algorithm>
 #include <cstddef>
+#include <iostream>
 #include <vector>
 
 struct LinearPage {
@@ -15,9 +16,11 @@ struct LinearPage {
       : base_ptr(ptr), total_size(size), used_offset(0) {}
 };
 
-class LinearAllocator {
+// Las paginas se piden a un Backend con malloc/free (un heap buddy o un
+// frente multi-arena).
+template <class Backend> class LinearAllocator {
 public:
-  LinearAllocator(Buddy_allocation &buddy_ref, size_t pageSize);
+  LinearAllocator(Backend &buddy_ref, size_t pageSize);
   ~LinearAllocator();
 
   void *allocate(size_t size);
@@ -27,9 +30,64 @@ public:
   size_t get_total_allocated() const;
 
 private:
-  Buddy_allocation &buddy;
+  Backend &buddy;
   size_t page_size;
   std::vector<LinearPage> pages;
 };
 
+template <class Backend>
+LinearAllocator<Backend>::LinearAllocator(Backend &buddy_ref, size_t pageSize)
+    : buddy(buddy_ref), page_size(pageSize) {}
+
+template <class Backend> LinearAllocator<Backend>::~LinearAllocator() {
+  reset();
+}
+
+template <class Backend>
+void *LinearAllocator<Backend>::allocate(size_t size) {
+  // Pagina existente
+  if (!pages.empty()) {
+    LinearPage &lasPage = pages.back();
+    size_t aligned_size = (size + 3) & ~3;
+
+    if (lasPage.used_offset + aligned_size <= lasPage.total_size) {
+      void *ptr = static_cast<char *>(lasPage.base_ptr) + lasPage.used_offset;
+      lasPage.used_offset += aligned_size;
+      return ptr;
+    }
+  }
+
+  // Pedir una nueva pagina
+  size_t new_page_req = std::max(page_size, size);
+  void *new_block = buddy.malloc(new_page_req);
+  if (!new_block)
+    return nullptr;
+
+  pages.emplace_back(new_block, new_page_req);
+  LinearPage &new_page = pages.back();
+  size_t aligned_size = (size + 3) & ~3;
+  void *ptr = new_page.base_ptr;
+  new_page.used_offset += aligned_size;
+
+  std::cout << "[LinearAllocator] Nueva Pagina creada " << new_page_req << '\n';
+  return ptr;
+}
+
+template <class Backend>
+bool LinearAllocator<Backend>::owns(void *ptr) const {
+  for (const auto &page : pages) {
+    if (ptr <= page.base_ptr &&
+        ptr < static_cast<char *>(page.base_ptr) + page.total_size)
+      return true;
+  }
+  return false;
+}
+
+template <class Backend> void LinearAllocator<Backend>::reset() {
+  for (auto &page : pages) {
+    buddy.free(page.base_ptr);
+  }
+  pages.clear();
+}
+
 #endif // LINEAR_H
@@ -12,6 +12,7 @@ public:
   void push(ListNode *);
   ListNode *pop();
   void remove();
+  bool empty() const;
   Block *transmute();
 };
 
@@ -0,0 +1,216 @@
+#pragma once
+#ifndef SHARD_H
+#define SHARD_H
+
+#include "buddy.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <sched.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Frente con una arena buddy por CPU: cada hilo reserva de la arena de la
+// CPU en la que corre (sched_getcpu) o de la que fije con set_thread_shard,
+// asi que hilos en CPUs distintas no comparten cerrojos ni lineas de cache
+// de los metadatos. Si su arena se agota, roba de las demas en orden
+// circular empezando por la siguiente.
+// Las arenas se crean todas en el constructor y estan alineadas a su tamano
+// (como en Buddy_arenas), asi que free encuentra la arena duena con
+// ptr >> log2(k_size) sin cerrojos, aunque libere otro hilo u otra CPU.
+// Un hilo puede migrar de CPU a mitad de una operacion y dos hilos pueden
+// compartir CPU, por eso cada arena sigue siendo concurrente.
+template <class Arena = Concurrent_buddy> class Buddy_shards {
+public:
+  static_assert(Arena::k_concurrent, "cada arena debe ser concurrente");
+
+  // shards = 0: una arena por CPU configurada
+  explicit Buddy_shards(const Buddy_options &options = Buddy_options(),
+                        size_t shards = 0);
+  Buddy_shards(const Buddy_shards &) = delete;
+  Buddy_shards &operator=(const Buddy_shards &) = delete;
+
+  void *malloc(const size_t);
+  void free(void *);
+  void free(void *, size_t size);
+  void *malloc_exact(const size_t);
+  void free_exact(void *, size_t size);
+  // Bytes que ocupa ptr de malloc_exact(size) en su arena
+  size_t exact_size(void *ptr, size_t size) const;
+
+  // Fija la arena del hilo actual (modulo shard_count) en lugar de la de su
+  // CPU; k_any_shard vuelve a sched_getcpu. Vale para todas las instancias.
+  static constexpr size_t k_any_shard = ~size_t(0);
+  static void set_thread_shard(size_t shard) { thread_shard = shard; }
+
+  size_t shard_count() const { return shards.size(); }
+  // Reservas servidas por una arena que no era la del hilo
+  size_t steals() const { return __atomic_load_n(&stolen, __ATOMIC_RELAXED); }
+
+  bool empty() const;
+  size_t largest_free_block() const;
+  bool can_allocate(size_t size) const;
+  size_t reserved_bytes() const;
+  size_t resident_bytes() const;
+  size_t released_bytes() const;
+  size_t metadata_bytes() const;
+  size_t managed_bytes() const { return shards.size() * Arena::k_size; }
+
+private:
+  static constexpr size_t k_arena_shift = log2(Arena::k_size);
+
+  std::vector<std::unique_ptr<Arena>> shards;
+  // Solo se escribe en el constructor: las busquedas no necesitan cerrojo
+  std::unordered_map<uintptr_t, Arena *> owners;
+  size_t stolen = 0;
+
+  static thread_local size_t thread_shard;
+
+  static uintptr_t key(const void *ptr) {
+    return reinterpret_cast<uintptr_t>(ptr) >> k_arena_shift;
+  }
+  size_t home() const;
+  template <class Allocate> void *allocate(size_t size, Allocate &&allocate);
+  Arena *owner(const void *ptr) const;
+};
+
+template <class Arena>
+thread_local size_t Buddy_shards<Arena>::thread_shard =
+    Buddy_shards<Arena>::k_any_shard;
+
+template <class Arena>
+Buddy_shards<Arena>::Buddy_shards(const Buddy_options &options,
+                                  size_t count) {
+  if (count == 0)
+    count = std::max<size_t>(1, std::thread::hardware_concurrency());
+  for (size_t i = 0; i < count; ++i) {
+    shards.push_back(std::make_unique<Arena>(options));
+    owners[key(shards.back()->heap_base)] = shards.back().get();
+  }
+}
+
+template <class Arena> size_t Buddy_shards<Arena>::home() const {
+  if (thread_shard != k_any_shard)
+    return thread_shard % shards.size();
+  const int cpu = sched_getcpu();
+  return cpu < 0 ? 0 : static_cast<size_t>(cpu) % shards.size();
+}
+
+template <class Arena> void *Buddy_shards<Arena>::malloc(const size_t size) {
+  return allocate(size, [size](Arena *arena) { return arena->malloc(size); });
+}
+
+template <class Arena>
+void *Buddy_shards<Arena>::malloc_exact(const size_t size) {
+  return allocate(size,
+                  [size](Arena *arena) { return arena->malloc_exact(size); });
+}
+
+// Recorrido comun de malloc y malloc_exact: la arena del hilo y, si esta
+// agotada, las demas a partir de la siguiente
+template <class Arena>
+template <class Allocate>
+void *Buddy_shards<Arena>::allocate(size_t size, Allocate &&allocate) {
+  if (size == 0 || size > Arena::k_size)
+    return nullptr;
+
+  const size_t first = home();
+  if (void *ptr = allocate(shards[first].get()))
+    return ptr;
+  for (size_t i = 1; i < shards.size(); ++i) {
+    Arena *arena = shards[(first + i) % shards.size()].get();
+    // Sin cerrojo: si se equivoca solo se salta o se intenta una arena
+    if (!arena->can_allocate(size))
+      continue;
+    if (void *ptr = allocate(arena)) {
+      __atomic_fetch_add(&stolen, 1, __ATOMIC_RELAXED);
+      return ptr;
+    }
+  }
+  return nullptr;
+}
+
+template <class Arena> void Buddy_shards<Arena>::free(void *ptr) {
+  if (Arena *arena = owner(ptr))
+    arena->free(ptr);
+}
+
+template <class Arena> void Buddy_shards<Arena>::free(void *ptr, size_t size) {
+  if (Arena *arena = owner(ptr))
+    arena->free(ptr, size);
+}
+
+template <class Arena>
+void Buddy_shards<Arena>::free_exact(void *ptr, size_t size) {
+  if (Arena *arena = owner(ptr))
+    arena->free_exact(ptr, size);
+}
+
+template <class Arena>
+size_t Buddy_shards<Arena>::exact_size(void *ptr, size_t size) const {
+  Arena *arena = owner(ptr);
+  return arena ? arena->exact_size(ptr, size) : 0;
+}
+
+template <class Arena>
+Arena *Buddy_shards<Arena>::owner(const void *ptr) const {
+  if (!ptr)
+    return nullptr;
+  auto it = owners.find(key(ptr));
+  return it == owners.end() ? nullptr : it->second;
+}
+
+template <class Arena> bool Buddy_shards<Arena>::empty() const {
+  for (const auto &arena : shards)
+    if (!arena->empty())
+      return false;
+  return true;
+}
+
+template <class Arena>
+size_t Buddy_shards<Arena>::largest_free_block() const {
+  size_t largest = 0;
+  for (const auto &arena : shards)
+    largest = std::max(largest, arena->largest_free_block());
+  return largest;
+}
+
+template <class Arena>
+bool Buddy_shards<Arena>::can_allocate(size_t size) const {
+  for (const auto &arena : shards)
+    if (arena->can_allocate(size))
+      return true;
+  return false;
+}
+
+template <class Arena> size_t Buddy_shards<Arena>::reserved_bytes() const {
+  size_t total = 0;
+  for (const auto &arena : shards)
+    total += arena->reserved_bytes();
+  return total;
+}
+
+template <class Arena> size_t Buddy_shards<Arena>::resident_bytes() const {
+  size_t total = 0;
+  for (const auto &arena : shards)
+    total += arena->resident_bytes();
+  return total;
+}
+
+template <class Arena> size_t Buddy_shards<Arena>::released_bytes() const {
+  size_t total = 0;
+  for (const auto &arena : shards)
+    total += arena->released_bytes();
+  return total;
+}
+
+template <class Arena> size_t Buddy_shards<Arena>::metadata_bytes() const {
+  size_t total = 0;
+  for (const auto &arena : shards)
+    total += arena->metadata_bytes();
+  return total;
+}
+
+#endif // SHARD_H
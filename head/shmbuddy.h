@@ -0,0 +1,150 @@
+#pragma once
+#ifndef SHMBUDDY_H
+#define SHMBUDDY_H
+
+#include "lfbuddy.h"
+#include "vmem.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <new>
+
+// Heap buddy compartido entre procesos: el heap y todos sus metadatos viven
+// en un segmento memfd. Un proceso lo crea (Shared_buddy()) y los demas se
+// unen con su descriptor (Shared_buddy(fd)).
+// El motor es el de Lockfree_buddy: su estado es un arbol de bytes sin
+// punteros que solo se modifica con CAS, asi que sirve tal cual en memoria
+// compartida aunque cada proceso la proyecte en otra direccion, y un
+// proceso que muere a mitad de un malloc no deja ningun cerrojo tomado.
+// Un segmento recien creado esta a cero, que ya es un heap vacio valido.
+// Los punteros solo valen dentro de cada proceso: entre procesos los
+// bloques se pasan como desplazamientos (offset_of / at), sin copias.
+//
+// Disposicion del segmento (secciones alineadas a k_section_align):
+//   cabecera | arbol de estados | orden por granulo | heap
+template <size_t HeapSize, size_t MinBlock = Min_alloc> class Shared_buddy {
+public:
+  using Engine = Lockfree_buddy<HeapSize, MinBlock>;
+  static constexpr size_t k_size = HeapSize;
+  static constexpr size_t k_min_block = MinBlock;
+  static constexpr bool k_concurrent = true;
+
+  // Crea un segmento nuevo (lanza std::bad_alloc si no puede)
+  Shared_buddy();
+  // Se une al segmento fd de otro proceso. No se queda con fd; lanza
+  // std::bad_alloc si no es un heap con esta misma configuracion.
+  explicit Shared_buddy(int fd);
+  ~Shared_buddy();
+  Shared_buddy(const Shared_buddy &) = delete;
+  Shared_buddy &operator=(const Shared_buddy &) = delete;
+
+  // Descriptor del segmento para pasarlo a otros procesos (-1 si este
+  // proceso se unio a uno ajeno)
+  int fd() const { return segment; }
+
+  void *malloc(const size_t size) { return engine.malloc(size); }
+  void free(void *ptr) { engine.free(ptr); }
+  void free(void *ptr, size_t size) { engine.free(ptr, size); }
+
+  size_t offset_of(const void *ptr) const {
+    return static_cast<const char *>(ptr) - engine.heap_base;
+  }
+  void *at(size_t offset) const { return engine.heap_base + offset; }
+
+  bool owns(const void *ptr) const { return engine.owns(ptr); }
+  size_t usable_size(void *ptr) const { return engine.usable_size(ptr); }
+  bool empty() const { return engine.empty(); }
+  size_t largest_free_block() const { return engine.largest_free_block(); }
+  bool can_allocate(size_t size) const { return engine.can_allocate(size); }
+  size_t reserved_bytes() const { return engine.reserved_bytes(); }
+  size_t resident_bytes() const { return engine.resident_bytes(); }
+  size_t released_bytes() const { return 0; }
+  static constexpr size_t metadata_bytes() { return Engine::metadata_bytes(); }
+  static constexpr size_t managed_bytes() { return k_size; }
+  static constexpr size_t segment_bytes() { return k_heap_offset + k_size; }
+
+private:
+  struct Header {
+    char magic[8];
+    uint64_t heap_size;
+    uint64_t min_block;
+  };
+  static constexpr char k_magic[8] = {'B', 'U', 'D', 'D', 'Y', 'S', 'H', '1'};
+
+  // Mayor que cualquier tamano de pagina de Linux
+  static constexpr size_t k_section_align = 64 * 1024;
+  static constexpr size_t align(size_t n) {
+    return (n + k_section_align - 1) & ~(k_section_align - 1);
+  }
+  static constexpr size_t k_tree_offset = align(sizeof(Header));
+  static constexpr size_t k_order_offset =
+      k_tree_offset + align(Engine::tree_bytes());
+  static constexpr size_t k_heap_offset =
+      k_order_offset + align(Engine::order_bytes());
+
+  // Se inicializa antes que engine: check_segment valida el segmento antes
+  // de proyectar nada
+  int segment = -1;
+  Engine engine;
+
+  Shared_buddy(int fd, bool owned);
+  static int create_segment();
+  static int check_segment(int fd, bool owned);
+};
+
+template <size_t HeapSize, size_t MinBlock>
+Shared_buddy<HeapSize, MinBlock>::Shared_buddy()
+    : Shared_buddy(create_segment(), true) {}
+
+template <size_t HeapSize, size_t MinBlock>
+Shared_buddy<HeapSize, MinBlock>::Shared_buddy(int fd)
+    : Shared_buddy(fd, false) {}
+
+template <size_t HeapSize, size_t MinBlock>
+Shared_buddy<HeapSize, MinBlock>::Shared_buddy(int fd, bool owned)
+    : segment(check_segment(fd, owned)),
+      engine(static_cast<char *>(
+                 vmem::map_shared(fd, k_heap_offset, k_size, k_size)),
+             static_cast<uint8_t *>(vmem::map_shared(fd, k_tree_offset,
+                                                     Engine::tree_bytes(), 0)),
+             static_cast<uint8_t *>(vmem::map_shared(
+                 fd, k_order_offset, Engine::order_bytes(), 0))) {}
+
+template <size_t HeapSize, size_t MinBlock>
+Shared_buddy<HeapSize, MinBlock>::~Shared_buddy() {
+  vmem::close_shared(segment);
+}
+
+template <size_t HeapSize, size_t MinBlock>
+int Shared_buddy<HeapSize, MinBlock>::create_segment() {
+  const int fd = vmem::create_shared("buddy", segment_bytes());
+  auto header = static_cast<Header *>(
+      vmem::map_shared(fd, 0, sizeof(Header), 0));
+  std::copy(std::begin(k_magic), std::end(k_magic), header->magic);
+  header->heap_size = k_size;
+  header->min_block = MinBlock;
+  vmem::release(header, sizeof(Header));
+  return fd;
+}
+
+// Devuelve el descriptor que guardara la instancia (-1 si no es suyo)
+template <size_t HeapSize, size_t MinBlock>
+int Shared_buddy<HeapSize, MinBlock>::check_segment(int fd, bool owned) {
+  if (vmem::shared_size(fd) < segment_bytes())
+    throw std::bad_alloc();
+  auto header = static_cast<const Header *>(
+      vmem::map_shared(fd, 0, sizeof(Header), 0));
+  const bool valid =
+      std::equal(std::begin(k_magic), std::end(k_magic), header->magic) &&
+      header->heap_size == k_size && header->min_block == MinBlock;
+  vmem::release(const_cast<Header *>(header), sizeof(Header));
+  if (!valid)
+    throw std::bad_alloc();
+  return owned ? fd : -1;
+}
+
+// Configuracion equivalente a Default_buddy
+using Default_shared_buddy = Shared_buddy<64 * 1024 * 1024>;
+
+#endif // SHMBUDDY_H
@@ -11,7 +11,7 @@ public:
   Slab(size_t objectSize, size_t poolSize);
   ~Slab();
   void *allocate();
-  void free();
+  void free(void *ptr);
   bool owns(void *ptr) const;
 
 private:
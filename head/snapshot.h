@@ -0,0 +1,63 @@
+#pragma once
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstddef>
+#include <string>
+
+// Ficheros de instantanea: secciones alineadas a pagina para poder
+// proyectarlas con mmap directamente sobre una reserva existente.
+// Los errores de E/S no lanzan: se acumulan y se consultan con ok().
+
+// Escribe en un temporal junto a path y solo lo renombra sobre path en
+// finish(): un heap restaurado que aun proyecta el fichero anterior sigue
+// leyendo ese inodo, que no se trunca ni se modifica.
+class Snapshot_writer {
+public:
+  explicit Snapshot_writer(const char *path);
+  ~Snapshot_writer();
+  Snapshot_writer(const Snapshot_writer &) = delete;
+  Snapshot_writer &operator=(const Snapshot_writer &) = delete;
+
+  bool ok() const { return fd >= 0 && !failed; }
+  // Reserva una seccion de size bytes al final del fichero, alineada a
+  // pagina, y devuelve su desplazamiento
+  size_t section(size_t size);
+  // Copia size bytes de data al desplazamiento offset. Los tramos que son
+  // todo ceros no se escriben: quedan como huecos del fichero, que se leen
+  // a cero.
+  void write(size_t offset, const void *data, size_t size);
+  // Fija el tamano final, cierra el temporal y lo renombra sobre path;
+  // devuelve ok(). Si no se llama (o falla) el temporal se borra.
+  bool finish();
+
+private:
+  std::string path;
+  std::string temp_path;
+  int fd = -1;
+  size_t end = 0;
+  bool failed = false;
+};
+
+class Snapshot_reader {
+public:
+  explicit Snapshot_reader(const char *path);
+  ~Snapshot_reader();
+  Snapshot_reader(const Snapshot_reader &) = delete;
+  Snapshot_reader &operator=(const Snapshot_reader &) = delete;
+
+  bool ok() const { return fd >= 0; }
+  size_t size() const { return file_size; }
+  bool read(size_t offset, void *data, size_t size);
+  // Sustituye [base, base + size) por una proyeccion privada (copia en
+  // escritura) de la seccion en offset: las paginas se leen del fichero al
+  // tocarlas y las escrituras no llegan a el. base y offset alineados a
+  // pagina.
+  bool map(size_t offset, void *base, size_t size);
+
+private:
+  int fd = -1;
+  size_t file_size = 0;
+};
+
+#endif // SNAPSHOT_H
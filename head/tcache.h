@@ -0,0 +1,202 @@
+#pragma once
+#ifndef TCACHE_H
+#define TCACHE_H
+
+#include "buddy.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Caches por hilo delante de un heap buddy concurrente (como el tcache de
+// los allocators de proposito general). Cada hilo guarda unos pocos bloques
+// libres de los ordenes bajos (hasta 16 B << (CachedOrders - 1), 4 KB por
+// defecto): la mayoria de parejas malloc/free no tocan ni las listas
+// compartidas ni split_nodes.
+// Los bloques cacheados siguen marcados como asignados en el heap, asi que
+// conservan su orden en los metadatos. Cuando un bin supera BinCapacity se
+// devuelve la mitad al heap de una vez; al terminar el hilo se devuelve todo.
+template <class Heap = Concurrent_buddy, size_t CachedOrders = 9,
+          size_t BinCapacity = 32>
+class Buddy_tcache {
+public:
+  static_assert(Heap::k_concurrent, "el heap compartido debe ser concurrente");
+
+  explicit Buddy_tcache(const Buddy_options &options = Buddy_options());
+  ~Buddy_tcache();
+  Buddy_tcache(const Buddy_tcache &) = delete;
+  Buddy_tcache &operator=(const Buddy_tcache &) = delete;
+
+  void *malloc(const size_t);
+  void free(void *);
+  // Devuelve al heap todos los bloques cacheados por el hilo actual
+  void flush();
+
+  Heap &heap() { return shared; }
+
+private:
+  static constexpr size_t k_min_shift = log2(Heap::k_min_block);
+
+  // Lista simple intrusiva: el primer puntero del bloque libre es el enlace
+  struct Bin {
+    void *head = nullptr;
+    size_t count = 0;
+  };
+  struct Cache {
+    Buddy_tcache *owner = nullptr;
+    Bin bins[CachedOrders];
+  };
+  // Caches del hilo, una por instancia de Buddy_tcache que ha usado
+  struct Local {
+    std::vector<std::unique_ptr<Cache>> caches;
+    Cache *last = nullptr;
+    ~Local();
+  };
+
+  Heap shared;
+  // Caches de todos los hilos registrados en esta instancia
+  std::vector<Cache *> registered;
+
+  static thread_local Local local;
+  // Protege owner/registered entre la salida de hilos y el destructor
+  static std::mutex registry_lock;
+
+  Cache *local_cache();
+  void drain(Cache &, size_t order, size_t count);
+};
+
+template <class Heap, size_t CachedOrders, size_t BinCapacity>
+thread_local typename Buddy_tcache<Heap, CachedOrders, BinCapacity>::Local
+    Buddy_tcache<Heap, CachedOrders, BinCapacity>::local;
+
+template <class Heap, size_t CachedOrders, size_t BinCapacity>
+std::mutex Buddy_tcache<Heap, CachedOrders, BinCapacity>::registry_lock;
+
+template <class Heap, size_t CachedOrders, size_t BinCapacity>
+Buddy_tcache<Heap, CachedOrders, BinCapacity>::Buddy_tcache(
+    const Buddy_options &options)
+    : shared(options) {}
+
+template <class Heap, size_t CachedOrders, size_t BinCapacity>
+Buddy_tcache<Heap, CachedOrders, BinCapacity>::~Buddy_tcache() {
+  // Los bloques aun cacheados mueren con el heap; basta con desligarlos
+  std::lock_guard<std::mutex> guard(registry_lock);
+  for (Cache *cache : registered) {
+    cache->owner = nullptr;
+    for (Bin &bin : cache->bins)
+      bin = Bin();
+  }
+}
+
+template <class Heap, size_t CachedOrders, size_t BinCapacity>
+Buddy_tcache<Heap, CachedOrders, BinCapacity>::Local::~Local() {
+  std::lock_guard<std::mutex> guard(registry_lock);
+  for (auto &cache : caches) {
+    Buddy_tcache *owner = cache->owner;
+    if (!owner)
+      continue;
+    for (size_t order = 0; order < CachedOrders; ++order)
+      owner->drain(*cache, order, cache->bins[order].count);
+    auto &list = owner->registered;
+    for (auto it = list.begin(); it != list.end(); ++it) {
+      if (*it == cache.get()) {
+        list.erase(it);
+        break;
+      }
+    }
+  }
+}
+
+template <class Heap, size_t CachedOrders, size_t BinCapacity>
+typename Buddy_tcache<Heap, CachedOrders, BinCapacity>::Cache *
+Buddy_tcache<Heap, CachedOrders, BinCapacity>::local_cache() {
+  if (local.last && local.last->owner == this)
+    return local.last;
+
+  for (auto it = local.caches.begin(); it != local.caches.end();) {
+    // Caches de instancias ya destruidas
+    if (!(*it)->owner) {
+      it = local.caches.erase(it);
+      continue;
+    }
+    if ((*it)->owner == this) {
+      local.last = it->get();
+      return local.last;
+    }
+    ++it;
+  }
+
+  local.caches.push_back(std::make_unique<Cache>());
+  Cache *cache = local.caches.back().get();
+  cache->owner = this;
+  {
+    std::lock_guard<std::mutex> guard(registry_lock);
+    registered.push_back(cache);
+  }
+  local.last = cache;
+  return cache;
+}
+
+template <class Heap, size_t CachedOrders, size_t BinCapacity>
+void *Buddy_tcache<Heap, CachedOrders, BinCapacity>::malloc(const size_t size) {
+  const size_t order = log2(std::max(size, Heap::k_min_block)) - k_min_shift;
+  if (size == 0 || order >= CachedOrders)
+    return shared.malloc(size);
+
+  Bin &bin = local_cache()->bins[order];
+  if (!bin.head)
+    return shared.malloc(size);
+
+  void *ptr = bin.head;
+  bin.head = *static_cast<void **>(ptr);
+  bin.count--;
+  return ptr;
+}
+
+template <class Heap, size_t CachedOrders, size_t BinCapacity>
+void Buddy_tcache<Heap, CachedOrders, BinCapacity>::free(void *ptr) {
+  if (!shared.owns(ptr))
+    return;
+
+  const size_t order = log2(shared.usable_size(ptr)) - k_min_shift;
+  if (order >= CachedOrders) {
+    shared.free(ptr);
+    return;
+  }
+
+  Cache *cache = local_cache();
+  Bin &bin = cache->bins[order];
+  *static_cast<void **>(ptr) = bin.head;
+  bin.head = ptr;
+  // Desborde: se devuelve la mitad del bin en un solo lote
+  if (++bin.count > BinCapacity)
+    drain(*cache, order, BinCapacity / 2);
+}
+
+template <class Heap, size_t CachedOrders, size_t BinCapacity>
+void Buddy_tcache<Heap, CachedOrders, BinCapacity>::flush() {
+  Cache *cache = local_cache();
+  for (size_t order = 0; order < CachedOrders; ++order)
+    drain(*cache, order, cache->bins[order].count);
+}
+
+template <class Heap, size_t CachedOrders, size_t BinCapacity>
+void Buddy_tcache<Heap, CachedOrders, BinCapacity>::drain(Cache &cache,
+                                                          size_t order,
+                                                          size_t count) {
+  // Un bin nunca pasa de BinCapacity + 1 bloques. El lote se devuelve con
+  // free_bulk, que toma los cerrojos del heap una vez por orden.
+  Bin &bin = cache.bins[order];
+  void *batch[BinCapacity + 1];
+  size_t n = 0;
+  for (; count && bin.head; --count) {
+    batch[n++] = bin.head;
+    bin.head = *static_cast<void **>(bin.head);
+    bin.count--;
+  }
+  if (n)
+    shared.free_bulk(batch, n);
+}
+
+#endif // TCACHE_H
@@ -0,0 +1,361 @@
+#pragma once
+#ifndef TLSF_H
+#define TLSF_H
+
+#include "buddy.h"
+#include "vmem.h"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+// Motor TLSF (Two-Level Segregated Fit, Masmano et al.): malloc y free en
+// tiempo constante en el peor caso, sin redondear a potencias de 2.
+// Los bloques libres se reparten en listas por dos niveles de tamano: el
+// primero es la potencia de 2 (fl) y el segundo la divide en
+// k_second_level partes iguales (sl). Dos mapas de bits (uno por nivel)
+// dicen que listas tienen bloques, asi que encontrar una lista con un bloque
+// suficiente son dos ctz. El tamano pedido se redondea hacia arriba al
+// principio de la siguiente subdivision: cualquier bloque de esa lista sirve
+// sin recorrerla (good fit).
+// Cada bloque lleva una cabecera de k_header bytes con su tamano y un
+// puntero al bloque fisicamente anterior, para fusionar con los dos vecinos
+// al liberar sin buscar nada. Los bloques libres guardan ademas los enlaces
+// de su lista en los primeros bytes de la carga.
+// El sobrante de un bloque mayor que lo pedido vuelve a su lista, asi que
+// la fragmentacion interna es como mucho MinBlock - 1 bytes mas la cabecera.
+// No es concurrente.
+template <size_t HeapSize, size_t MinBlock = Min_alloc> class Tlsf_allocation {
+public:
+  static constexpr size_t k_size = HeapSize;
+  static constexpr size_t k_min_block = MinBlock;
+  static constexpr bool k_concurrent = false;
+
+  explicit Tlsf_allocation(const Buddy_options &options = Buddy_options());
+  ~Tlsf_allocation();
+  Tlsf_allocation(const Tlsf_allocation &) = delete;
+  Tlsf_allocation &operator=(const Tlsf_allocation &) = delete;
+
+  void *malloc(const size_t);
+  void free(void *);
+  // El tamano ya esta en la cabecera
+  void free(void *ptr, size_t) { free(ptr); }
+  // TLSF ya parte los bloques al tamano pedido
+  void *malloc_exact(const size_t size) { return malloc(size); }
+  void free_exact(void *ptr, size_t) { free(ptr); }
+  // Puede superar lo pedido si el sobrante no llegaba a un bloque libre
+  size_t exact_size(void *ptr, size_t) const { return usable_size(ptr); }
+
+  char *heap_base = nullptr;
+
+  bool owns(const void *ptr) const {
+    return ptr >= heap_base && ptr < heap_base + k_size;
+  }
+  size_t usable_size(void *ptr) const { return header_of(ptr)->size(); }
+  bool empty() const;
+  // Recorre solo la lista no vacia mas alta
+  size_t largest_free_block() const;
+  bool can_allocate(size_t size) const;
+  size_t reserved_bytes() const { return heap_reserved; }
+  size_t resident_bytes() const {
+    return vmem::resident_bytes(heap_base, heap_reserved);
+  }
+  // Mapas de bits y cabezas de lista; las cabeceras de bloque van dentro del
+  // heap (k_header bytes por bloque)
+  static constexpr size_t metadata_bytes() {
+    return sizeof(uint32_t) * (k_first_level + 1) +
+           sizeof(void *) * k_first_level * k_second_level;
+  }
+  static constexpr size_t managed_bytes() { return k_size; }
+  size_t released_bytes() const { return 0; }
+
+  static constexpr size_t k_header = 2 * sizeof(void *);
+
+private:
+  static_assert((HeapSize & (HeapSize - 1)) == 0,
+                "HeapSize no es potencia de 2");
+  static_assert((MinBlock & (MinBlock - 1)) == 0,
+                "MinBlock no es potencia de 2");
+  static_assert(MinBlock >= k_header,
+                "MinBlock no puede ser menor que la cabecera de bloque");
+
+  // Subdivisiones de cada potencia de 2 (2^5: error de redondeo < 1/32)
+  static constexpr size_t k_second_level_log2 = 5;
+  static constexpr size_t k_second_level = size_t(1) << k_second_level_log2;
+  // Por debajo de k_small_block el primer nivel 0 se divide linealmente en
+  // pasos de MinBlock
+  static constexpr size_t k_first_level_shift =
+      k_second_level_log2 + log2(MinBlock);
+  static constexpr size_t k_small_block = size_t(1) << k_first_level_shift;
+  static constexpr size_t k_first_level =
+      log2(HeapSize) - k_first_level_shift + 1;
+  static_assert(k_first_level <= 32, "Demasiados niveles para fl_map");
+  // Un bloque libre debe poder alojar sus enlaces
+  static constexpr size_t k_min_payload =
+      std::max(MinBlock, 2 * sizeof(void *));
+
+  static constexpr size_t k_free_bit = 0x1;
+  static constexpr size_t k_prev_free_bit = 0x2;
+
+  // La cabecera precede a la carga; next_free/prev_free solo son validos
+  // en bloques libres y ocupan el principio de la carga
+  struct Block {
+    Block *prev_phys;
+    size_t size_flags;
+    Block *next_free;
+    Block *prev_free;
+
+    size_t size() const { return size_flags & ~(k_free_bit | k_prev_free_bit); }
+    void set_size(size_t size) {
+      size_flags = size | (size_flags & (k_free_bit | k_prev_free_bit));
+    }
+    bool is_free() const { return size_flags & k_free_bit; }
+    bool is_prev_free() const { return size_flags & k_prev_free_bit; }
+    void set_free(bool free) {
+      size_flags = free ? size_flags | k_free_bit : size_flags & ~k_free_bit;
+    }
+    void set_prev_free(bool free) {
+      size_flags =
+          free ? size_flags | k_prev_free_bit : size_flags & ~k_prev_free_bit;
+    }
+    char *payload() { return reinterpret_cast<char *>(this) + k_header; }
+    Block *next_phys() {
+      return reinterpret_cast<Block *>(payload() + size());
+    }
+  };
+
+  // Bit fl a 1 si alguna lista de ese primer nivel tiene bloques
+  uint32_t fl_map = 0;
+  uint32_t sl_maps[k_first_level] = {};
+  Block *free_lists[k_first_level][k_second_level] = {};
+  vmem::Backing heap_backing = vmem::Backing::normal;
+  size_t heap_reserved = k_size;
+
+  static Block *header_of(const void *ptr) {
+    return reinterpret_cast<Block *>(const_cast<char *>(
+        static_cast<const char *>(ptr) - k_header));
+  }
+  static size_t adjust(size_t size) {
+    return std::max(k_min_payload, (size + MinBlock - 1) & ~(MinBlock - 1));
+  }
+  static size_t msb(size_t n) { return 63 - __builtin_clzll(n); }
+  // Lista donde se guarda un bloque libre de size bytes
+  static void mapping(size_t size, size_t &fl, size_t &sl);
+  // Primera lista cuyos bloques tienen todos al menos size bytes
+  static void mapping_search(size_t size, size_t &fl, size_t &sl);
+  Block *find_suitable(size_t &fl, size_t &sl) const;
+
+  void insert(Block *);
+  void remove(Block *);
+  void remove(Block *, size_t fl, size_t sl);
+  Block *merge_prev(Block *);
+  Block *merge_next(Block *);
+  void split(Block *, size_t size);
+};
+
+// Configuracion equivalente a Default_buddy
+using Default_tlsf = Tlsf_allocation<64 * 1024 * 1024>;
+
+template <size_t HeapSize, size_t MinBlock>
+Tlsf_allocation<HeapSize, MinBlock>::Tlsf_allocation(
+    const Buddy_options &options) {
+  heap_base = static_cast<char *>(vmem::reserve_heap(
+      k_size, options.huge_pages, heap_reserved, heap_backing));
+  // Todo el heap es un bloque libre seguido de un centinela ocupado de
+  // tamano 0 que corta la fusion por la derecha
+  auto block = reinterpret_cast<Block *>(heap_base);
+  block->prev_phys = nullptr;
+  block->size_flags = 0;
+  block->set_size(k_size - 2 * k_header);
+  Block *sentinel = block->next_phys();
+  sentinel->prev_phys = block;
+  sentinel->size_flags = 0;
+  insert(block);
+}
+
+template <size_t HeapSize, size_t MinBlock>
+Tlsf_allocation<HeapSize, MinBlock>::~Tlsf_allocation() {
+  vmem::release(heap_base, heap_reserved);
+}
+
+template <size_t HeapSize, size_t MinBlock>
+void Tlsf_allocation<HeapSize, MinBlock>::mapping(size_t size, size_t &fl,
+                                                  size_t &sl) {
+  if (size < k_small_block) {
+    fl = 0;
+    sl = size / MinBlock;
+  } else {
+    const size_t bit = msb(size);
+    sl = (size >> (bit - k_second_level_log2)) ^ k_second_level;
+    fl = bit - k_first_level_shift + 1;
+  }
+}
+
+template <size_t HeapSize, size_t MinBlock>
+void Tlsf_allocation<HeapSize, MinBlock>::mapping_search(size_t size,
+                                                         size_t &fl,
+                                                         size_t &sl) {
+  if (size >= k_small_block)
+    size += (size_t(1) << (msb(size) - k_second_level_log2)) - 1;
+  mapping(size, fl, sl);
+}
+
+template <size_t HeapSize, size_t MinBlock>
+typename Tlsf_allocation<HeapSize, MinBlock>::Block *
+Tlsf_allocation<HeapSize, MinBlock>::find_suitable(size_t &fl,
+                                                   size_t &sl) const {
+  if (fl >= k_first_level)
+    return nullptr;
+  uint32_t sl_map = sl_maps[fl] & (~uint32_t(0) << sl);
+  if (!sl_map) {
+    const uint32_t fl_candidates =
+        fl + 1 < 32 ? fl_map & (~uint32_t(0) << (fl + 1)) : 0;
+    if (!fl_candidates)
+      return nullptr;
+    fl = __builtin_ctz(fl_candidates);
+    sl_map = sl_maps[fl];
+  }
+  sl = __builtin_ctz(sl_map);
+  return free_lists[fl][sl];
+}
+
+template <size_t HeapSize, size_t MinBlock>
+void Tlsf_allocation<HeapSize, MinBlock>::insert(Block *block) {
+  size_t fl, sl;
+  mapping(block->size(), fl, sl);
+  Block *head = free_lists[fl][sl];
+  block->next_free = head;
+  block->prev_free = nullptr;
+  if (head)
+    head->prev_free = block;
+  free_lists[fl][sl] = block;
+  fl_map |= uint32_t(1) << fl;
+  sl_maps[fl] |= uint32_t(1) << sl;
+  block->set_free(true);
+  block->next_phys()->set_prev_free(true);
+}
+
+template <size_t HeapSize, size_t MinBlock>
+void Tlsf_allocation<HeapSize, MinBlock>::remove(Block *block) {
+  size_t fl, sl;
+  mapping(block->size(), fl, sl);
+  remove(block, fl, sl);
+}
+
+template <size_t HeapSize, size_t MinBlock>
+void Tlsf_allocation<HeapSize, MinBlock>::remove(Block *block, size_t fl,
+                                                 size_t sl) {
+  if (block->next_free)
+    block->next_free->prev_free = block->prev_free;
+  if (block->prev_free) {
+    block->prev_free->next_free = block->next_free;
+  } else {
+    free_lists[fl][sl] = block->next_free;
+    if (!block->next_free) {
+      sl_maps[fl] &= ~(uint32_t(1) << sl);
+      if (!sl_maps[fl])
+        fl_map &= ~(uint32_t(1) << fl);
+    }
+  }
+  block->set_free(false);
+  block->next_phys()->set_prev_free(false);
+}
+
+// Absorbe el bloque siguiente en block (ninguno de los dos en una lista)
+template <size_t HeapSize, size_t MinBlock>
+typename Tlsf_allocation<HeapSize, MinBlock>::Block *
+Tlsf_allocation<HeapSize, MinBlock>::merge_next(Block *block) {
+  Block *next = block->next_phys();
+  block->set_size(block->size() + k_header + next->size());
+  block->next_phys()->prev_phys = block;
+  return block;
+}
+
+template <size_t HeapSize, size_t MinBlock>
+typename Tlsf_allocation<HeapSize, MinBlock>::Block *
+Tlsf_allocation<HeapSize, MinBlock>::merge_prev(Block *block) {
+  Block *prev = block->prev_phys;
+  remove(prev);
+  return merge_next(prev);
+}
+
+// Deja block (ocupado) con size bytes y devuelve el resto a las listas
+template <size_t HeapSize, size_t MinBlock>
+void Tlsf_allocation<HeapSize, MinBlock>::split(Block *block, size_t size) {
+  if (block->size() < size + k_header + k_min_payload)
+    return;
+  const size_t rest_size = block->size() - size - k_header;
+  block->set_size(size);
+  Block *rest = block->next_phys();
+  rest->prev_phys = block;
+  rest->size_flags = 0;
+  rest->set_size(rest_size);
+  rest->next_phys()->prev_phys = rest;
+  // Si el siguiente estaba libre, block lo habria absorbido al liberarse
+  insert(rest);
+}
+
+template <size_t HeapSize, size_t MinBlock>
+void *Tlsf_allocation<HeapSize, MinBlock>::malloc(const size_t request) {
+  if (request == 0 || request > k_size)
+    return nullptr;
+
+  const size_t size = adjust(request);
+  size_t fl, sl;
+  mapping_search(size, fl, sl);
+  Block *block = find_suitable(fl, sl);
+  if (!block)
+    return nullptr;
+  remove(block, fl, sl);
+  split(block, size);
+  return block->payload();
+}
+
+template <size_t HeapSize, size_t MinBlock>
+void Tlsf_allocation<HeapSize, MinBlock>::free(void *ptr) {
+  if (!owns(ptr))
+    return;
+
+  Block *block = header_of(ptr);
+#ifdef BUDDY_DEBUG
+  assert(!block->is_free() && "doble free");
+#endif
+  if (block->is_prev_free())
+    block = merge_prev(block);
+  Block *next = block->next_phys();
+  if (next->is_free()) {
+    remove(next);
+    merge_next(block);
+  }
+  insert(block);
+}
+
+template <size_t HeapSize, size_t MinBlock>
+bool Tlsf_allocation<HeapSize, MinBlock>::empty() const {
+  auto first = reinterpret_cast<const Block *>(heap_base);
+  return first->is_free() && first->size() == k_size - 2 * k_header;
+}
+
+template <size_t HeapSize, size_t MinBlock>
+size_t Tlsf_allocation<HeapSize, MinBlock>::largest_free_block() const {
+  if (!fl_map)
+    return 0;
+  const size_t fl = msb(fl_map);
+  const size_t sl = msb(sl_maps[fl]);
+  size_t largest = 0;
+  for (const Block *block = free_lists[fl][sl]; block;
+       block = block->next_free)
+    largest = std::max(largest, block->size());
+  return largest;
+}
+
+template <size_t HeapSize, size_t MinBlock>
+bool Tlsf_allocation<HeapSize, MinBlock>::can_allocate(size_t size) const {
+  if (size == 0 || size > k_size)
+    return false;
+  size_t fl, sl;
+  mapping_search(adjust(size), fl, sl);
+  return find_suitable(fl, sl) != nullptr;
+}
+
+#endif // TLSF_H
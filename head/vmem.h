@@ -0,0 +1,66 @@
+#pragma once
+#ifndef VMEM_H
+#define VMEM_H
+
+#include <cstddef>
+
+// Envoltorio minimo sobre la memoria virtual del sistema (mmap/munmap).
+// Las regiones se reservan sin comprometer memoria fisica: cada pagina se
+// asigna (y se llena de ceros) la primera vez que se toca.
+namespace vmem {
+
+constexpr size_t k_huge_page = 2 * 1024 * 1024;
+
+enum class Backing {
+  normal,           // paginas base (4 KB)
+  explicit_huge,    // MAP_HUGETLB: paginas de 2 MB del pool del sistema
+  transparent_huge, // madvise(MADV_HUGEPAGE): THP a criterio del kernel
+};
+
+size_t page_size();
+
+// Reserva size bytes de lectura/escritura; lanza std::bad_alloc si falla
+void *reserve(size_t size);
+// Igual que reserve pero con la base alineada a alignment (potencia de 2)
+void *reserve_aligned(size_t size, size_t alignment);
+// Reserva respaldada por paginas de 2 MB y alineada a alignment (al menos
+// 2 MB): intenta MAP_HUGETLB y, si el sistema no tiene paginas reservadas,
+// recurre a THP. size se redondea a un multiplo de k_huge_page; backing
+// indica el resultado.
+void *reserve_huge(size_t size, size_t alignment, Backing &backing);
+// Reserva de un heap de size bytes (potencia de 2) alineado a su tamano:
+// con huge, reserve_huge (reserved crece al menos a k_huge_page); si no,
+// reserve_aligned con backing normal. reserved recibe lo que hay que pasar
+// a release.
+void *reserve_heap(size_t size, bool huge, size_t &reserved, Backing &backing);
+void release(void *base, size_t size);
+// Devuelve al sistema las paginas completas (de granularity bytes) dentro de
+// [base, base + size) sin deshacer la reserva: el siguiente acceso las vuelve
+// a comprometer a cero. lazy usa MADV_FREE (el kernel solo las recupera bajo
+// presion) en lugar de MADV_DONTNEED. Devuelve los bytes descartados.
+size_t discard(void *base, size_t size, size_t granularity, bool lazy);
+// Como discard, pero sustituye esas paginas por una proyeccion anonima nueva
+// (mmap MAP_FIXED). Sirve tambien sobre una proyeccion privada de un
+// fichero, donde MADV_DONTNEED volveria a leer el fichero en lugar de dar
+// ceros.
+size_t discard_anonymous(void *base, size_t size, size_t granularity);
+
+// Bytes de [base, base + size) que estan realmente en memoria (mincore)
+size_t resident_bytes(const void *base, size_t size);
+
+// Segmento de memoria compartida anonimo (memfd) de size bytes, a cero y sin
+// comprometer. Devuelve su descriptor, que se hereda con fork/exec o se
+// envia a otro proceso por un socket (SCM_RIGHTS); lanza std::bad_alloc si
+// falla.
+int create_shared(const char *name, size_t size);
+// Proyecta compartidos size bytes del segmento fd desde offset (alineado a
+// pagina) con la base alineada a alignment (0 = pagina); lanza
+// std::bad_alloc si falla. Se deshace con release.
+void *map_shared(int fd, size_t offset, size_t size, size_t alignment);
+// Tamano actual del segmento (0 si fd no es valido)
+size_t shared_size(int fd);
+void close_shared(int fd);
+
+} // namespace vmem
+
+#endif // VMEM_H
@@ -0,0 +1,296 @@
+#pragma once
+#ifndef WBUDDY_H
+#define WBUDDY_H
+
+#include "buddy.h"
+#include "list.h"
+#include "vmem.h"
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+// Motor buddy ponderado (weighted buddy, Shen y Peterson): ademas de los
+// bloques de 2^k granulos hay bloques de 3 * 2^k, asi que entre dos
+// potencias de 2 hay un tamano intermedio y la fragmentacion interna maxima
+// baja de ~50% a ~33%.
+//   2^k       se parte en 3 * 2^(k-2) (izquierda) + 2^(k-2) (derecha)
+//   3 * 2^k   se parte en 2^(k+1)     (izquierda) + 2^k     (derecha)
+//   2         se parte en 1 + 1 (no hay 3 * 2^-1)
+// Clases: la par 2j son bloques de 2^j granulos y la impar 2j + 1 de
+// 3 * 2^(j-1) (la clase 1 no existe).
+//
+// Como un bloque de 2^k puede ser hijo derecho de dos padres distintos, la
+// posicion no basta para encontrar al companero: cada bloque guarda en el
+// primer granulo una etiqueta de 16 bits con su clase, su lado, el tipo de
+// particion de su padre y un bit de memoria (Cranston y Thomas). Al partir,
+// el hijo izquierdo guarda el lado y el tipo del padre y el derecho su bit
+// de memoria; al fusionar se recompone la etiqueta del padre con esos bits.
+// Las listas libres son como las de Buddy_allocation (un ListNode dentro de
+// cada bloque libre). No es concurrente.
+template <size_t HeapSize, size_t MinBlock = Min_alloc> class Weighted_buddy {
+public:
+  static constexpr size_t k_size = HeapSize;
+  static constexpr size_t k_min_block = MinBlock;
+  static constexpr bool k_concurrent = false;
+  static constexpr size_t k_granules = k_size / MinBlock;
+  static constexpr size_t k_root_class = 2 * log2(k_granules);
+  static constexpr size_t k_class_count = k_root_class + 1;
+
+  explicit Weighted_buddy(const Buddy_options &options = Buddy_options());
+  ~Weighted_buddy();
+  Weighted_buddy(const Weighted_buddy &) = delete;
+  Weighted_buddy &operator=(const Weighted_buddy &) = delete;
+
+  void *malloc(const size_t);
+  void free(void *);
+  // La etiqueta ya guarda la clase: el tamano solo se comprueba
+  void free(void *, size_t size);
+  // Los tamanos intermedios ya recortan la cola: la reserva exacta es el
+  // bloque de la clase mas ajustada
+  void *malloc_exact(const size_t size) { return malloc(size); }
+  void free_exact(void *ptr, size_t size) { free(ptr, size); }
+  size_t exact_size(void *ptr, size_t) const { return usable_size(ptr); }
+
+  char *heap_base = nullptr;
+
+  bool owns(const void *ptr) const {
+    return ptr >= heap_base && ptr < heap_base + k_size;
+  }
+  size_t usable_size(void *ptr) const {
+    return class_bytes(tags[granule_of(ptr)] & k_class_mask);
+  }
+  bool empty() const { return tags[0] == (k_root_class | k_free); }
+  size_t largest_free_block() const {
+    return free_classes ? class_bytes(63 - __builtin_clzll(free_classes)) : 0;
+  }
+  // Cualquier bloque libre de una clase mayor se puede partir hasta la
+  // pedida
+  bool can_allocate(size_t size) const {
+    return size && size <= k_size &&
+           (free_classes >> class_for(granules_for(size))) != 0;
+  }
+  size_t reserved_bytes() const { return heap_reserved + k_tag_bytes; }
+  size_t resident_bytes() const {
+    return vmem::resident_bytes(heap_base, heap_reserved) +
+           vmem::resident_bytes(tags, k_tag_bytes);
+  }
+  // Una etiqueta de 16 bits por granulo
+  static constexpr size_t metadata_bytes() { return k_tag_bytes; }
+  static constexpr size_t managed_bytes() { return k_size; }
+  size_t released_bytes() const { return 0; }
+
+  // Granulos de un bloque de clase c
+  static constexpr size_t class_granules(size_t c) {
+    return c & 1 ? size_t(3) << (c - 3) / 2 : size_t(1) << c / 2;
+  }
+  static constexpr size_t class_bytes(size_t c) {
+    return class_granules(c) * MinBlock;
+  }
+  // Menor clase con al menos n granulos
+  static constexpr size_t class_for(size_t n) {
+    const size_t k = log2(n);
+    return k >= 2 && (size_t(3) << (k - 2)) >= n ? 2 * k - 1 : 2 * k;
+  }
+
+private:
+  static_assert((HeapSize & (HeapSize - 1)) == 0,
+                "HeapSize no es potencia de 2");
+  static_assert((MinBlock & (MinBlock - 1)) == 0,
+                "MinBlock no es potencia de 2");
+  static_assert(MinBlock >= sizeof(ListNode),
+                "MinBlock debe poder alojar un ListNode");
+  static_assert(k_class_count <= 64, "Demasiadas clases para free_classes");
+
+  static constexpr uint16_t k_class_mask = 0x3f;
+  static constexpr uint16_t k_right = 0x40;       // hijo derecho de su padre
+  static constexpr uint16_t k_memory = 0x80;      // bit guardado del padre
+  static constexpr uint16_t k_odd_parent = 0x100; // padre de clase impar
+  static constexpr uint16_t k_pair_parent = 0x200; // padre de clase 2
+  static constexpr uint16_t k_parent_kind = k_odd_parent | k_pair_parent;
+  static constexpr uint16_t k_free = 0x400;
+
+  static constexpr size_t k_tag_bytes = k_granules * sizeof(uint16_t);
+
+  ListNode free_lists[k_class_count] = {};
+  // Bit c a 1 si la lista de la clase c no esta vacia
+  uint64_t free_classes = 0;
+  // Etiqueta de cada bloque en su primer granulo (el resto no se lee)
+  uint16_t *tags = nullptr;
+  vmem::Backing heap_backing = vmem::Backing::normal;
+  size_t heap_reserved = k_size;
+
+  static constexpr size_t granules_for(size_t size) {
+    return (size + MinBlock - 1) / MinBlock;
+  }
+  static constexpr size_t left_class(size_t parent) {
+    return parent == 2 ? 0 : parent - 1;
+  }
+  static constexpr size_t right_class(size_t parent) {
+    return parent == 2 ? 0 : parent - (parent & 1 ? 3 : 4);
+  }
+  // Tipo de particion de parent, que su hijo derecho necesita para subir
+  static constexpr uint16_t kind_of(size_t parent) {
+    return parent == 2 ? k_pair_parent : parent & 1 ? k_odd_parent : 0;
+  }
+  // Un hijo izquierdo de clase c solo puede venir de una clase
+  static constexpr size_t parent_of_left(size_t c) {
+    return c == 0 ? 2 : c + 1;
+  }
+  static constexpr size_t parent_of_right(size_t c, uint16_t tag) {
+    return c + (tag & k_pair_parent ? 2 : tag & k_odd_parent ? 3 : 4);
+  }
+  size_t granule_of(const void *ptr) const {
+    return (static_cast<const char *>(ptr) - heap_base) / MinBlock;
+  }
+  ListNode *node_at(size_t granule) {
+    return reinterpret_cast<ListNode *>(heap_base + granule * MinBlock);
+  }
+
+  void push_free(size_t granule, size_t c);
+  size_t pop_free(size_t c);
+  void remove_free(size_t granule, size_t c);
+  void split(size_t granule, size_t c);
+};
+
+// Configuracion equivalente a Default_buddy
+using Default_weighted_buddy = Weighted_buddy<64 * 1024 * 1024>;
+
+template <size_t HeapSize, size_t MinBlock>
+Weighted_buddy<HeapSize, MinBlock>::Weighted_buddy(
+    const Buddy_options &options) {
+  heap_base = static_cast<char *>(vmem::reserve_heap(
+      k_size, options.huge_pages, heap_reserved, heap_backing));
+  tags = static_cast<uint16_t *>(vmem::reserve(k_tag_bytes));
+  tags[0] = k_root_class;
+  push_free(0, k_root_class);
+}
+
+template <size_t HeapSize, size_t MinBlock>
+Weighted_buddy<HeapSize, MinBlock>::~Weighted_buddy() {
+  vmem::release(heap_base, heap_reserved);
+  vmem::release(tags, k_tag_bytes);
+}
+
+template <size_t HeapSize, size_t MinBlock>
+void Weighted_buddy<HeapSize, MinBlock>::push_free(size_t granule, size_t c) {
+  ListNode *node = node_at(granule);
+  // el bloque puede contener datos de un uso anterior
+  node->prev = nullptr;
+  node->next = nullptr;
+  free_lists[c].push(node);
+  tags[granule] |= k_free;
+  free_classes |= uint64_t(1) << c;
+}
+
+template <size_t HeapSize, size_t MinBlock>
+size_t Weighted_buddy<HeapSize, MinBlock>::pop_free(size_t c) {
+  const size_t granule = granule_of(free_lists[c].pop());
+  if (free_lists[c].empty())
+    free_classes &= ~(uint64_t(1) << c);
+  tags[granule] &= ~k_free;
+  return granule;
+}
+
+template <size_t HeapSize, size_t MinBlock>
+void Weighted_buddy<HeapSize, MinBlock>::remove_free(size_t granule,
+                                                     size_t c) {
+  node_at(granule)->remove();
+  if (free_lists[c].empty())
+    free_classes &= ~(uint64_t(1) << c);
+  tags[granule] &= ~k_free;
+}
+
+// Parte el bloque (no libre) de clase c en granule y etiqueta sus hijos
+template <size_t HeapSize, size_t MinBlock>
+void Weighted_buddy<HeapSize, MinBlock>::split(size_t granule, size_t c) {
+  const uint16_t parent = tags[granule];
+  const size_t right = granule + class_granules(left_class(c));
+  tags[granule] = static_cast<uint16_t>(left_class(c) |
+                                        (parent & k_right ? k_memory : 0) |
+                                        (parent & k_parent_kind));
+  tags[right] = static_cast<uint16_t>(right_class(c) | k_right |
+                                      (parent & k_memory) | kind_of(c));
+}
+
+template <size_t HeapSize, size_t MinBlock>
+void *Weighted_buddy<HeapSize, MinBlock>::malloc(const size_t request) {
+  if (request == 0 || request > k_size)
+    return nullptr;
+
+  const size_t wanted = class_for(granules_for(request));
+  const uint64_t candidates = free_classes >> wanted;
+  if (!candidates)
+    return nullptr;
+  size_t c = wanted + __builtin_ctzll(candidates);
+  size_t granule = pop_free(c);
+
+  // Se baja por el hijo mas pequeno que siga sirviendo; el otro queda libre
+  while (c > wanted) {
+    const size_t left = left_class(c);
+    const size_t right = right_class(c);
+    split(granule, c);
+    if (right >= wanted) {
+      push_free(granule, left);
+      granule += class_granules(left);
+      c = right;
+    } else {
+      push_free(granule + class_granules(left), right);
+      c = left;
+    }
+  }
+  return heap_base + granule * MinBlock;
+}
+
+template <size_t HeapSize, size_t MinBlock>
+void Weighted_buddy<HeapSize, MinBlock>::free(void *ptr) {
+  if (!owns(ptr))
+    return;
+
+  size_t granule = granule_of(ptr);
+  uint16_t tag = tags[granule];
+#ifdef BUDDY_DEBUG
+  assert(!(tag & k_free) && "doble free");
+#endif
+  size_t c = tag & k_class_mask;
+  while (c != k_root_class) {
+    size_t parent, left, right, buddy, buddy_class;
+    if (tag & k_right) {
+      parent = parent_of_right(c, tag);
+      right = granule;
+      buddy_class = left_class(parent);
+      left = buddy = granule - class_granules(buddy_class);
+    } else {
+      parent = parent_of_left(c);
+      left = granule;
+      right = buddy = granule + class_granules(c);
+      buddy_class = right_class(parent);
+    }
+    // En el primer granulo del companero siempre hay una etiqueta valida:
+    // la suya o la de su descendiente mas a la izquierda
+    const uint16_t other = tags[buddy];
+    if (!(other & k_free) || (other & k_class_mask) != buddy_class)
+      break;
+    remove_free(buddy, buddy_class);
+    const uint16_t left_tag = tags[left], right_tag = tags[right];
+    tag = static_cast<uint16_t>(parent | (left_tag & k_memory ? k_right : 0) |
+                                (right_tag & k_memory) |
+                                (left_tag & k_parent_kind));
+    tags[left] = tag;
+    granule = left;
+    c = parent;
+  }
+  push_free(granule, c);
+}
+
+template <size_t HeapSize, size_t MinBlock>
+void Weighted_buddy<HeapSize, MinBlock>::free(void *ptr, size_t size) {
+#ifdef BUDDY_DEBUG
+  assert((!owns(ptr) || size <= usable_size(ptr)) &&
+         "free con un tamano mayor que el bloque");
+#else
+  (void)size;
+#endif
+  free(ptr);
+}
+
+#endif // WBUDDY_H
@@ -1,6 +1,11 @@
+#include "head/arena.h"
 #include "head/buddy.h"
+#include "head/lfbuddy.h"
 #include "head/linear.h"
+#include "head/shard.h"
 #include "head/slab.h"
+#include "head/tlsf.h"
+#include "head/wbuddy.h"
 #include <algorithm>
 #include <cstring>
 #include <iomanip>
@@ -23,11 +28,25 @@ struct VRAMResource {
         name(std::move(n)), allocate_type(type) {}
 };
 
-class VRAMManager {
+// Numero de heaps detras del backend (solo los frentes multi-arena y por CPU
+// tienen mas de uno)
+template <class Arena> size_t arena_count(const Buddy_arenas<Arena> &buddy) {
+  return buddy.arena_count();
+}
+template <class Arena> size_t arena_count(const Buddy_shards<Arena> &buddy) {
+  return buddy.shard_count();
+}
+template <class Heap> size_t arena_count(const Heap &) { return 1; }
+
+// Backend: heaps buddy de 64 MB que crecen bajo demanda por defecto, o el
+// motor sin cerrojos, el ponderado, TLSF o una arena por CPU para
+// compararlos (./test_buddy lockfree, weighted, tlsf o sharded)
+template <class Backend = Buddy_arenas<>> class VRAMManager {
 private:
-  Buddy_allocation buddy;
+  static constexpr size_t k_linear_page = 4 * 1024 * 1024;
+  Backend buddy;
   SlabAllocator slab;
-  LinearAllocator linear;
+  LinearAllocator<Backend> linear;
   std::vector<VRAMResource> resources;
   size_t total_requested_memory = 0;
   size_t total_allocated_memory = 0;
@@ -36,8 +55,15 @@ private:
     std::cout << "[VRAM Manager] " << message << std::endl;
   }
 
+  static Buddy_options buddy_options() {
+    Buddy_options options;
+    // Las texturas grandes que se liberan no deben fijar RSS para siempre
+    options.release_size = 1024 * 1024;
+    return options;
+  }
+
 public:
-  VRAMManager() : linear(buddy, 4 * 1024 * 1024) {
+  VRAMManager() : buddy(buddy_options()), linear(buddy, k_linear_page) {
     log("Iniciando Sistema Híbrido (Buddy + Slab)\n");
   }
 
@@ -72,7 +98,7 @@ public:
       }
     }
 
-    if (!ptr && size <= 4 * 1024 * 1024) {
+    if (!ptr && size <= k_linear_page) {
       ptr = linear.allocate(size);
       if (ptr) {
         actual_size = (size + 3) & ~3;
@@ -81,12 +107,10 @@ public:
     }
 
     if (!ptr) {
-      ptr = buddy.malloc(size);
+      // Reserva exacta: la cola del bloque potencia de 2 vuelve al buddy
+      ptr = buddy.malloc_exact(size);
       if (ptr) {
-        size_t power_of_2 = 16; // Min_alloc
-        while (power_of_2 < size)
-          power_of_2 *= 2;
-        actual_size = power_of_2;
+        actual_size = buddy.exact_size(ptr, size);
         type = "BUDDY";
       }
     }
@@ -110,6 +134,18 @@ public:
     log("Iniciando carga de imagen: " + filename);
     int width, height, channels;
 
+    // Las texturas grandes van al buddy: si no caben no merece la pena
+    // decodificarlas. stbi_info solo lee la cabecera.
+    if (stbi_info(filename.c_str(), &width, &height, &channels)) {
+      const size_t size = size_t(width) * height * channels;
+      if (size > k_linear_page && !buddy.can_allocate(size)) {
+        std::cerr << "  Error: no hay bloque libre de " << size
+                  << " bytes para " << filename << " (mayor libre: "
+                  << buddy.largest_free_block() << ")\n";
+        return nullptr;
+      }
+    }
+
     unsigned char *data =
         stbi_load(filename.c_str(), &width, &height, &channels, 0); //
     if (!data) {
@@ -145,7 +181,9 @@ public:
         slab.free(ptr);
       } else if (it->allocate_type == "LINEAR") {
       } else {
-        buddy.free(ptr);
+        // El tamano pedido ya esta en el recurso: free_exact reconstruye
+        // los trozos conservados sin leer metadatos
+        buddy.free_exact(ptr, it->requested_size);
       }
       std::cout << "  > Memoria en " << ptr << " liberada.\n";
       resources.erase(it);
@@ -167,13 +205,24 @@ public:
     std::cout << "Memoria Asignada:   " << total_allocated_memory << " bytes\n";
     std::cout << "Fragmentación:      " << std::fixed << std::setprecision(2)
               << frag << "%\n";
+    std::cout << "Arenas buddy:       " << arena_count(buddy) << "\n";
+    std::cout << "Buddy reservado:    " << buddy.reserved_bytes()
+              << " bytes\n";
+    std::cout << "Buddy residente:    " << buddy.resident_bytes()
+              << " bytes\n";
+    std::cout << "Buddy devuelto SO:  " << buddy.released_bytes()
+              << " bytes\n";
+    std::cout << "Metadatos buddy:    " << buddy.metadata_bytes() << " bytes ("
+              << std::setprecision(3)
+              << 100.0 * buddy.metadata_bytes() / buddy.managed_bytes()
+              << "% del heap)\n";
     std::cout << "=======================\n\n";
   }
 };
 
-void run_experiment() {
+template <class Backend> void run_experiment() {
 
-  VRAMManager vram;
+  VRAMManager<Backend> vram;
 
   std::cout << "--- Test 1: Textura 704KB ---\n";
   void *tex1 = vram.load_image_to_vram("prueba01.jpg");
@@ -194,7 +243,16 @@ void run_experiment() {
   vram.print_report();
 }
 
-int main() {
-  run_experiment();
+int main(int argc, char **argv) {
+  if (argc > 1 && std::string(argv[1]) == "lockfree")
+    run_experiment<Default_lockfree_buddy>();
+  else if (argc > 1 && std::string(argv[1]) == "weighted")
+    run_experiment<Default_weighted_buddy>();
+  else if (argc > 1 && std::string(argv[1]) == "tlsf")
+    run_experiment<Default_tlsf>();
+  else if (argc > 1 && std::string(argv[1]) == "sharded")
+    run_experiment<Buddy_shards<>>();
+  else
+    run_experiment<Buddy_arenas<>>();
   return 0;
 }
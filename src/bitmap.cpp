@@ -0,0 +1,67 @@
+#include "../head/bitmap.h"
+
+size_t Level_bitmap::words_for(size_t bits) {
+  size_t total = 0;
+  size_t words = (bits + 63) / 64;
+  for (;;) {
+    total += words;
+    if (words <= 1)
+      return total;
+    words = (words + 63) / 64;
+  }
+}
+
+void Level_bitmap::attach(uint64_t *words, size_t bits) {
+  level_count = 0;
+  bit_count = bits;
+  size_t count = (bits + 63) / 64;
+  for (;;) {
+    levels[level_count++] = words;
+    words += count;
+    if (count <= 1)
+      return;
+    count = (count + 63) / 64;
+  }
+}
+
+void Level_bitmap::set(size_t i) {
+  for (size_t level = 0; level < level_count; ++level) {
+    uint64_t &word = levels[level][i / 64];
+    const bool was_empty = word == 0;
+    word |= uint64_t(1) << (i % 64);
+    // El nivel superior ya sabia que esta palabra tenia bits
+    if (!was_empty)
+      return;
+    i /= 64;
+  }
+}
+
+void Level_bitmap::clear(size_t i) {
+  for (size_t level = 0; level < level_count; ++level) {
+    uint64_t &word = levels[level][i / 64];
+    word &= ~(uint64_t(1) << (i % 64));
+    if (word)
+      return;
+    i /= 64;
+  }
+}
+
+bool Level_bitmap::test(size_t i) const {
+  return (levels[0][i / 64] >> (i % 64)) & 1;
+}
+
+size_t Level_bitmap::find_first() const {
+  if (!level_count || !levels[level_count - 1][0])
+    return npos;
+  size_t i = 0;
+  for (size_t level = level_count; level-- > 0;)
+    i = i * 64 + __builtin_ctzll(levels[level][i]);
+  return i;
+}
+
+size_t Level_bitmap::count() const {
+  size_t total = 0;
+  for (size_t i = 0; level_count && i < (bit_count + 63) / 64; ++i)
+    total += __builtin_popcountll(levels[0][i]);
+  return total;
+}
@@ -28,6 +28,8 @@ void ListNode::remove() {
   next = nullptr;
 }
 
+bool ListNode::empty() const { return next == this; }
+
 Block *ListNode::transmute() {
   assert(!prev && !next);
   auto block = reinterpret_cast<Block *>(this);
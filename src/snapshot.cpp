@@ -0,0 +1,131 @@
+#include "../head/snapshot.h"
+#include "../head/vmem.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// Tramo que se escribe (o se deja como hueco si es todo ceros) de una vez
+constexpr size_t k_write_chunk = 256 * 1024;
+
+bool all_zero(const char *data, size_t size) {
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+    uint64_t word;
+    std::memcpy(&word, data + i, sizeof(word));
+    if (word)
+      return false;
+  }
+  for (; i < size; ++i)
+    if (data[i])
+      return false;
+  return true;
+}
+
+bool write_all(int fd, const char *data, size_t size, size_t offset) {
+  while (size) {
+    const ssize_t done = pwrite(fd, data, size, offset);
+    if (done <= 0)
+      return false;
+    data += done;
+    size -= done;
+    offset += done;
+  }
+  return true;
+}
+
+} // namespace
+
+Snapshot_writer::Snapshot_writer(const char *path)
+    : path(path), temp_path(std::string(path) + ".XXXXXX") {
+  fd = mkstemp(&temp_path[0]);
+  // mkstemp crea el fichero con permisos 0600
+  if (fd >= 0 && fchmod(fd, 0644) != 0)
+    failed = true;
+}
+
+Snapshot_writer::~Snapshot_writer() {
+  if (fd >= 0) {
+    close(fd);
+    unlink(temp_path.c_str());
+  }
+}
+
+size_t Snapshot_writer::section(size_t size) {
+  const size_t page = vmem::page_size();
+  const size_t offset = end;
+  end += (size + page - 1) & ~(page - 1);
+  return offset;
+}
+
+void Snapshot_writer::write(size_t offset, const void *data, size_t size) {
+  if (!ok())
+    return;
+  const char *bytes = static_cast<const char *>(data);
+  for (size_t done = 0; done < size; done += k_write_chunk) {
+    const size_t count = std::min(k_write_chunk, size - done);
+    // El temporal es nuevo: un hueco ya se lee a cero
+    if (all_zero(bytes + done, count))
+      continue;
+    if (!write_all(fd, bytes + done, count, offset + done)) {
+      failed = true;
+      return;
+    }
+  }
+}
+
+bool Snapshot_writer::finish() {
+  if (fd < 0)
+    return false;
+  if (ftruncate(fd, end) != 0)
+    failed = true;
+  if (close(fd) != 0)
+    failed = true;
+  fd = -1;
+  if (failed || std::rename(temp_path.c_str(), path.c_str()) != 0) {
+    unlink(temp_path.c_str());
+    failed = true;
+  }
+  return !failed;
+}
+
+Snapshot_reader::Snapshot_reader(const char *path)
+    : fd(open(path, O_RDONLY)) {
+  struct stat info;
+  if (fd >= 0 && fstat(fd, &info) == 0)
+    file_size = static_cast<size_t>(info.st_size);
+}
+
+Snapshot_reader::~Snapshot_reader() {
+  if (fd >= 0)
+    close(fd);
+}
+
+bool Snapshot_reader::read(size_t offset, void *data, size_t size) {
+  if (offset + size > file_size)
+    return false;
+  char *bytes = static_cast<char *>(data);
+  while (size) {
+    const ssize_t done = pread(fd, bytes, size, offset);
+    if (done <= 0)
+      return false;
+    bytes += done;
+    size -= done;
+    offset += done;
+  }
+  return true;
+}
+
+bool Snapshot_reader::map(size_t offset, void *base, size_t size) {
+  if (offset + size > file_size)
+    return false;
+  return mmap(base, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd,
+              offset) != MAP_FAILED;
+}
@@ -0,0 +1,191 @@
+#include "../head/vmem.h"
+#include <algorithm>
+#include <cstdint>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+constexpr int k_reserve_flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+
+// mmap de size bytes con la base alineada a alignment. Si mmap ya garantiza
+// esa alineacion (natural) no hace falta reservar de mas; si no, se reserva
+// size + alignment y se recortan los extremos sobrantes.
+void *map_aligned(size_t size, size_t alignment, size_t natural, int prot,
+                  int flags) {
+  const size_t extra = alignment > natural ? alignment : 0;
+  void *raw_ptr = mmap(nullptr, size + extra, prot, flags, -1, 0);
+  if (raw_ptr == MAP_FAILED)
+    return nullptr;
+  if (!extra)
+    return raw_ptr;
+
+  char *raw = static_cast<char *>(raw_ptr);
+  const uintptr_t addr = reinterpret_cast<uintptr_t>(raw);
+  char *base = reinterpret_cast<char *>((addr + alignment - 1) &
+                                        ~(uintptr_t(alignment) - 1));
+  const size_t head = base - raw;
+  const size_t tail = extra - head;
+  if (head)
+    munmap(raw, head);
+  if (tail)
+    munmap(base + size, tail);
+  return base;
+}
+
+} // namespace
+
+size_t vmem::page_size() {
+  static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  return size;
+}
+
+void *vmem::reserve(size_t size) { return reserve_aligned(size, 0); }
+
+void *vmem::reserve_aligned(size_t size, size_t alignment) {
+  void *base = map_aligned(size, alignment, page_size(),
+                           PROT_READ | PROT_WRITE, k_reserve_flags);
+  if (!base)
+    throw std::bad_alloc();
+  return base;
+}
+
+void *vmem::reserve_huge(size_t size, size_t alignment, Backing &backing) {
+  size = (size + k_huge_page - 1) & ~(k_huge_page - 1);
+  alignment = std::max(alignment, k_huge_page);
+
+  // La ventana alineada se busca con una reserva normal sin acceso ni
+  // memoria comprometida: con MAP_HUGETLB el exceso de size + alignment
+  // tambien saldria del pool antes de recortarlo.
+  void *base = map_aligned(size, alignment, page_size(), PROT_NONE,
+                           k_reserve_flags);
+  if (!base)
+    throw std::bad_alloc();
+
+  // Paginas explicitas sobre exactamente size bytes de la ventana: se
+  // reservan al hacer mmap, asi que el fallo (pool vacio o insuficiente) se
+  // detecta aqui y no con un SIGBUS posterior
+  if (mmap(base, size, PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_FIXED, -1,
+           0) != MAP_FAILED) {
+    backing = Backing::explicit_huge;
+    return base;
+  }
+
+  // Un MAP_FIXED fallido puede haber deshecho ya parte de la ventana
+  munmap(base, size);
+  base = reserve_aligned(size, alignment);
+  backing = madvise(base, size, MADV_HUGEPAGE) == 0 ? Backing::transparent_huge
+                                                    : Backing::normal;
+  return base;
+}
+
+void *vmem::reserve_heap(size_t size, bool huge, size_t &reserved,
+                         Backing &backing) {
+  if (huge) {
+    reserved = std::max(size, k_huge_page);
+    return reserve_huge(reserved, size, backing);
+  }
+  reserved = size;
+  backing = Backing::normal;
+  return reserve_aligned(size, size);
+}
+
+void vmem::release(void *base, size_t size) {
+  if (base)
+    munmap(base, size);
+}
+
+size_t vmem::discard_anonymous(void *base, size_t size, size_t granularity) {
+  const uintptr_t begin = (reinterpret_cast<uintptr_t>(base) + granularity -
+                           1) & ~(uintptr_t(granularity) - 1);
+  const uintptr_t end =
+      (reinterpret_cast<uintptr_t>(base) + size) & ~(uintptr_t(granularity) - 1);
+  if (end <= begin)
+    return 0;
+  if (mmap(reinterpret_cast<void *>(begin), end - begin,
+           PROT_READ | PROT_WRITE, k_reserve_flags | MAP_FIXED, -1,
+           0) == MAP_FAILED)
+    return 0;
+  return end - begin;
+}
+
+size_t vmem::discard(void *base, size_t size, size_t granularity, bool lazy) {
+  const uintptr_t begin = (reinterpret_cast<uintptr_t>(base) + granularity -
+                           1) & ~(uintptr_t(granularity) - 1);
+  const uintptr_t end =
+      (reinterpret_cast<uintptr_t>(base) + size) & ~(uintptr_t(granularity) - 1);
+  if (end <= begin)
+    return 0;
+
+  void *first = reinterpret_cast<void *>(begin);
+#ifdef MADV_FREE
+  // MADV_FREE no existe para hugetlbfs; en ese caso se usa MADV_DONTNEED
+  if (lazy && madvise(first, end - begin, MADV_FREE) == 0)
+    return end - begin;
+#else
+  (void)lazy;
+#endif
+  if (madvise(first, end - begin, MADV_DONTNEED) != 0)
+    return 0;
+  return end - begin;
+}
+
+int vmem::create_shared(const char *name, size_t size) {
+  const int fd = memfd_create(name, 0);
+  if (fd < 0)
+    throw std::bad_alloc();
+  if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+    close(fd);
+    throw std::bad_alloc();
+  }
+  return fd;
+}
+
+void *vmem::map_shared(int fd, size_t offset, size_t size, size_t alignment) {
+  // Se reserva primero el hueco alineado y se sustituye por el segmento
+  void *base = reserve_aligned(size, alignment);
+  if (mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd,
+           static_cast<off_t>(offset)) == MAP_FAILED) {
+    munmap(base, size);
+    throw std::bad_alloc();
+  }
+  return base;
+}
+
+size_t vmem::shared_size(int fd) {
+  struct stat info;
+  if (fd < 0 || fstat(fd, &info) != 0)
+    return 0;
+  return static_cast<size_t>(info.st_size);
+}
+
+void vmem::close_shared(int fd) {
+  if (fd >= 0)
+    close(fd);
+}
+
+size_t vmem::resident_bytes(const void *base, size_t size) {
+  const size_t page = page_size();
+  const uintptr_t begin = reinterpret_cast<uintptr_t>(base) & ~(page - 1);
+  const uintptr_t end = reinterpret_cast<uintptr_t>(base) + size;
+  const size_t pages = (end - begin + page - 1) / page;
+
+  // mincore rellena un byte por pagina; se consulta por tramos para no
+  // necesitar un vector del tamano de la reserva completa
+  constexpr size_t k_chunk = 64 * 1024;
+  std::vector<unsigned char> vec(std::min(pages, k_chunk));
+  size_t resident = 0;
+  for (size_t first = 0; first < pages; first += k_chunk) {
+    const size_t count = std::min(pages - first, k_chunk);
+    if (mincore(reinterpret_cast<void *>(begin + first * page), count * page,
+                vec.data()) != 0)
+      return 0;
+    for (size_t i = 0; i < count; ++i)
+      resident += vec[i] & 1;
+  }
+  return std::min(resident * page, size);
+}